@@ -1,6 +1,6 @@
 include RMCIOS-build-scripts/utilities.mk
 
-SOURCES:=labjack-u12-module.c
+SOURCES:=labjack-u12-module.c lj12_device.c ljconv.c ljspool.c ljtrig.c ljadapt.c lj12_backend.c lj12sim.c lj12_trace.c ljtrace.c
 FILENAME:=labjack-module
 GCC?=${TOOL_PREFIX}gcc
 DLLTOOL?=${TOOL_PREFIX}dlltool
@@ -23,20 +23,30 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "RMCIOS-functions.h"
 #include "labjack.h"
-
-tEAnalogIn EAnalogIn;
-tEAnalogOut EAnalogOut;
-tEDigitalIn EDigitalIn;
-tEDigitalOut EDigitalOut;
+#include "lj12_backend.h"
+#include "lj12_trace.h"
+#include "lj12_device.h"
+#include "ljtrace.h"
+#include "ljconv.h"
+#include "ljspool.h"
+#include "ljtrig.h"
+#include "ljadapt.h"
+#include "ljtime.h"
+#include "ljthread.h"
 
 struct lja_data
 {
-   long idnum;
+   struct lj12_device *device;
    int channel;
    int gain;
+   ljseq_t seq;         // Publishes voltage, value and adapt to readers
    float voltage;
+   double value;        // voltage after conversion
+   struct ljconv_data *conversion;
+   struct ljadapt_data adapt;
 };
 
 void labjack_ai_func (struct lja_data *this,
@@ -53,6 +63,13 @@ void labjack_ai_func (struct lja_data *this,
                      "help for labjack ai. Commands:\r\n"
                      "create ljad ch_name | channel\r\n"
                      "setup ljad channel(0-11) | gain(0-7) | idnum(-1)"
+                     "setup ljad conversion conversion_channel\r\n"
+                     "  #Convert voltage with ljconv channel\r\n"
+                     "setup ljad adaptive min_interval max_interval"
+                     " | deadband(0)\r\n"
+                     "  #Poll at min_interval seconds while voltage changes\r\n"
+                     "  #and back off to max_interval while stable\r\n"
+                     "read ljad saved #read bus seconds saved by adaptive\r\n"
                      "write ljad #aquire voltage\r\n"
                      "read ljad #read voltage\r\n");
       break;
@@ -71,9 +88,14 @@ void labjack_ai_func (struct lja_data *this,
       create_channel_param (context, paramtype, param, 0, 
                             (class_rmcios) labjack_ai_func, this);        
 
-      this->idnum = -1;
+      this->device = lj12_device_get (-1);
       this->gain = 0;
       this->channel = 0;
+      this->seq = 0;
+      this->voltage = 0;
+      this->value = 0;
+      this->conversion = NULL;
+      ljadapt_init (&this->adapt);
       if (num_params < 2) break;
       this->channel = param_to_int (context, paramtype, param, 1);
       break;
@@ -83,28 +105,121 @@ void labjack_ai_func (struct lja_data *this,
          break;
       if (num_params < 1)
          break;
+      if (num_params > 1)
+      {
+         char keyword[20];
+         param_to_string (context, paramtype, param, 0,
+                          sizeof (keyword), keyword);
+         if (strcmp (keyword, "conversion") == 0)
+         {
+            this->conversion =
+               ljconv_find (param_to_int (context, paramtype, param, 1));
+            if (this->conversion == NULL)
+               printf ("ljai: Could not find conversion channel\r\n");
+            break;
+         }
+         if (strcmp (keyword, "adaptive") == 0)
+         {
+            double deadband = 0;
+            if (num_params < 3)
+               break;
+            if (num_params > 3)
+               deadband = param_to_float (context, paramtype, param, 3);
+            ljadapt_setup (&this->adapt,
+                           param_to_float (context, paramtype, param, 1),
+                           param_to_float (context, paramtype, param, 2),
+                           deadband);
+            break;
+         }
+      }
       this->channel = param_to_int (context, paramtype, param, 0);
       if (num_params < 2)
          break;
       this->gain = param_to_int (context, paramtype, param, 1);
       if (num_params < 3)
          break;
-      this->idnum = param_to_int (context, paramtype, param, 2);
+      this->device =
+         lj12_device_get (param_to_int (context, paramtype, param, 2));
 
    case read_rmcios:
       if (this == NULL)
          break;
-      return_float (context, returnv, this->voltage);
+      if (function == read_rmcios && num_params > 0)
+      {
+         char keyword[20];
+         param_to_string (context, paramtype, param, 0,
+                          sizeof (keyword), keyword);
+         if (strcmp (keyword, "saved") == 0)
+         {
+            double saved;
+            unsigned seq;
+            do
+            {
+               seq = ljseq_read_begin (&this->seq);
+               saved = this->adapt.saved_time;
+            }
+            while (ljseq_read_retry (&this->seq, seq));
+            return_float (context, returnv, (float) saved);
+            break;
+         }
+      }
+      {
+         double value;
+         unsigned seq;
+         do
+         {
+            seq = ljseq_read_begin (&this->seq);
+            value = this->value;
+         }
+         while (ljseq_read_retry (&this->seq, seq));
+         return_float (context, returnv, (float) value);
+      }
       break;
 
    case write_rmcios:
       if (this == NULL)
          break;
-      long overVoltage;
-      EAnalogIn (&this->idnum, 0, this->channel, 
-                 this->gain, &overVoltage, &this->voltage);
-
-      write_f (context, linked_channels (context, id), this->voltage);
+      {
+         double value;
+         double start;
+         struct lj12_unit *unit = lj12_device_lock (this->device);
+         start = ljtime_monotonic ();
+         if (ljadapt_due (&this->adapt, start))
+         {
+            long overVoltage;
+            float voltage = 0;
+            long err;
+            long idnum = lj12_unit_id (unit);
+            err = EAnalogIn (&idnum, 0, this->channel, this->gain,
+                             &overVoltage, &voltage);
+            lj12_device_check (this->device, err);
+            if (err != 0)
+            {
+               // Keep the last value and retry on next write
+               lj12_unit_unlock (unit);
+               printf ("ljai: EAnalogIn error %ld\r\n", err);
+               break;
+            }
+            value = voltage;
+            ljconv_apply (this->conversion, &value, 1);
+
+            ljseq_write_begin (&this->seq);
+            ljadapt_update (&this->adapt, voltage, start,
+                            ljtime_monotonic () - start);
+            this->voltage = voltage;
+            this->value = value;
+            ljseq_write_end (&this->seq);
+         }
+         else
+         {
+            ljseq_write_begin (&this->seq);
+            ljadapt_skip (&this->adapt);
+            ljseq_write_end (&this->seq);
+         }
+         value = this->value;
+         lj12_unit_unlock (unit);
+         write_f (context, linked_channels (context, id), (float) value);
+      }
       break;
    }
 }
@@ -139,7 +254,8 @@ void labjack_ao_func (struct lja_data *this,
       create_channel_param (context, paramtype, param, 0, 
                             (class_rmcios) labjack_ao_func, this); 
 
-      this->idnum = -1;
+      this->device = lj12_device_get (-1);
+      this->seq = 0;
       this->voltage = 0;
       this->channel = 0;
       if (num_params < 2)
@@ -156,32 +272,54 @@ void labjack_ao_func (struct lja_data *this,
       this->channel = param_to_int (context, paramtype, param, 0);
       if (num_params < 2)
          break;
-      this->idnum = param_to_int (context, paramtype, param, 1);
+      this->device =
+         lj12_device_get (param_to_int (context, paramtype, param, 1));
       break;
    case write_rmcios:
       if (this == NULL)
          break;
-      this->voltage = param_to_float (context, paramtype, param, 0);
-      if (this->channel == 0)
-         EAnalogOut (&this->idnum, 0, this->voltage, -1.0);
-      if (this->channel == 1)
-         EAnalogOut (&this->idnum, 0, -1.0, this->voltage);
-      write_f (context, linked_channels (context, id), this->voltage);
+      {
+         float voltage = param_to_float (context, paramtype, param, 0);
+         long idnum;
+         struct lj12_unit *unit = lj12_device_lock (this->device);
+         idnum = lj12_unit_id (unit);
+         if (this->channel == 0)
+            lj12_device_check (this->device,
+                               EAnalogOut (&idnum, 0, voltage, -1.0));
+         if (this->channel == 1)
+            lj12_device_check (this->device,
+                               EAnalogOut (&idnum, 0, -1.0, voltage));
+         ljseq_write_begin (&this->seq);
+         this->voltage = voltage;
+         ljseq_write_end (&this->seq);
+         lj12_unit_unlock (unit);
+         write_f (context, linked_channels (context, id), voltage);
+      }
       break;
    case read_rmcios:
       if (this == NULL)
          break;
-      return_float (context, returnv, this->voltage);
+      {
+         float voltage;
+         unsigned seq;
+         do
+         {
+            seq = ljseq_read_begin (&this->seq);
+            voltage = this->voltage;
+         }
+         while (ljseq_read_retry (&this->seq, seq));
+         return_float (context, returnv, voltage);
+      }
       break;
    }
 }
 
 struct ljd_data
 {
-   long idnum;
+   struct lj12_device *device;
    int channel;
    int terminalD;
-   long state;
+   long state;          // Accessed atomically by readers and writers
 };
 
 void labjack_do_func (struct ljd_data *this,
@@ -217,7 +355,7 @@ void labjack_do_func (struct ljd_data *this,
       create_channel_param (context, paramtype, param, 0, 
                             (class_rmcios) labjack_do_func, this); 
 
-      this->idnum = -1;
+      this->device = lj12_device_get (-1);
       this->channel = 0;
       this->terminalD = 0;
       this->state = 0;
@@ -237,22 +375,32 @@ void labjack_do_func (struct ljd_data *this,
       this->terminalD = param_to_int (context, paramtype, param, 1);
       if (num_params < 3)
          break;
-      this->idnum = param_to_int (context, paramtype, param, 2);
+      this->device =
+         lj12_device_get (param_to_int (context, paramtype, param, 2));
       break;
 
    case write_rmcios:
       if (this == NULL)
          break;
-      this->state = param_to_int (context, paramtype, param, 0);
-      EDigitalOut (&this->idnum,
-                   0, this->channel, this->terminalD, this->state);
-      write_i (context, linked_channels (context, id), this->state);
+      {
+         long state = param_to_int (context, paramtype, param, 0);
+         long idnum;
+         struct lj12_unit *unit = lj12_device_lock (this->device);
+         idnum = lj12_unit_id (unit);
+         lj12_device_check (this->device,
+                            EDigitalOut (&idnum, 0, this->channel,
+                                         this->terminalD, state));
+         __atomic_store_n (&this->state, state, __ATOMIC_RELEASE);
+         lj12_unit_unlock (unit);
+         write_i (context, linked_channels (context, id), state);
+      }
       break;
 
    case read_rmcios:
       if (this == NULL)
          break;
-      return_int (context, returnv, this->state);
+      return_int (context, returnv,
+                  __atomic_load_n (&this->state, __ATOMIC_ACQUIRE));
       break;
    }
 }
@@ -290,7 +438,7 @@ void labjack_di_func (struct ljd_data *this,
       create_channel_param (context, paramtype, param, 0, 
                             (class_rmcios) labjack_di_func, this); 
 
-      this->idnum = -1;
+      this->device = lj12_device_get (-1);
       this->channel = 0;
       this->terminalD = 0;
       this->state = 0;
@@ -310,47 +458,478 @@ void labjack_di_func (struct ljd_data *this,
       this->terminalD = param_to_int (context, paramtype, param, 1);
       if (num_params < 3)
          break;
-      this->idnum = param_to_int (context, paramtype, param, 2);
+      this->device =
+         lj12_device_get (param_to_int (context, paramtype, param, 2));
       break;
 
    case write_rmcios:
       if (this == NULL)
          break;
-      EDigitalIn (&this->idnum,
-                  0, this->channel, this->terminalD, &this->state);
-      write_i (context, linked_channels (context, id), this->state);
+      {
+         long state = __atomic_load_n (&this->state, __ATOMIC_RELAXED);
+         long idnum;
+         struct lj12_unit *unit = lj12_device_lock (this->device);
+         idnum = lj12_unit_id (unit);
+         lj12_device_check (this->device,
+                            EDigitalIn (&idnum, 0, this->channel,
+                                        this->terminalD, &state));
+         __atomic_store_n (&this->state, state, __ATOMIC_RELEASE);
+         lj12_unit_unlock (unit);
+         write_i (context, linked_channels (context, id), state);
+      }
       break;
 
    case read_rmcios:
       if (this == NULL)
          break;
-      return_float (context, returnv, this->state);
+      return_float (context, returnv,
+                    __atomic_load_n (&this->state, __ATOMIC_ACQUIRE));
       break;
    }
 }
 
-HINSTANCE hDLLInstance;
+struct ljcnt_data
+{
+   struct lj12_device *device;
+   int has_count;
+   double count;        // Latest hardware count
+   double ms;           // Driver timestamp of latest count
+   ljseq_t seq;         // Publishes total and rate to readers
+   double total;        // Accumulated count over counter overflows
+   double rate;         // Counts per second
+};
 
-void API_ENTRY_FUNC init_channels (const struct context_rmcios *context)
+void labjack_counter_func (struct ljcnt_data *this,
+                           const struct context_rmcios *context, int id,
+                           enum function_rmcios function,
+                           enum type_rmcios paramtype,
+                           struct combo_rmcios *returnv,
+                           int num_params, const union param_rmcios param)
 {
-   printf ("Labjack u12 module\r\n[" VERSION_STR "]\r\n");
-   //Now try and load the DLL.
-   if (hDLLInstance = LoadLibrary ("ljackuw.dll"))
+   switch (function)
    {
-      //If successfully loaded, get the address of the desired functions.
-      EAnalogIn = (tEAnalogIn) GetProcAddress (hDLLInstance, "EAnalogIn");
-      EAnalogOut = (tEAnalogOut) GetProcAddress (hDLLInstance, "EAnalogOut");
-      EDigitalOut =(tEDigitalOut) GetProcAddress (hDLLInstance, "EDigitalOut");
-      EDigitalIn = (tEDigitalIn) GetProcAddress (hDLLInstance, "EDigitalIn");
-
-      //AISample = (tAISample) GetProcAddress(hDLLInstance,"AISample");
-      create_channel_str (context, "ljai", (class_rmcios)labjack_ai_func, NULL);
-      create_channel_str (context, "ljao", (class_rmcios)labjack_ao_func, NULL);
-      create_channel_str (context, "ljdo", (class_rmcios)labjack_do_func, NULL);
-      create_channel_str (context, "ljdi", (class_rmcios)labjack_di_func, NULL);
+   case help_rmcios:
+      return_string (context, returnv,
+                     "help for labjack hardware counter. Commands:\r\n"
+                     "create ljcnt ch_name\r\n"
+                     "setup ljcnt idnum(-1) | reset(0)\r\n"
+                     "  #reset=1 clears the hardware counter on setup\r\n"
+                     "write ljcnt #read counter and send rate and total\r\n"
+                     "  #to linked channels as text: rate total\r\n"
+                     "read ljcnt #read latest rate (counts/s)\r\n"
+                     "read ljcnt total #read latest total count\r\n"
+                     "  #Total is returned as exact integer text\r\n");
+      break;
+
+   case create_rmcios:
+      if (num_params < 1)
+      {
+         printf ("Not enough parameters\r\n");
+         break;
+      }
+
+      // allocate new data
+      this = (struct ljcnt_data *) malloc (sizeof (struct ljcnt_data));
+
+      // create channel
+      create_channel_param (context, paramtype, param, 0,
+                            (class_rmcios) labjack_counter_func, this);
+
+      this->device = lj12_device_get (-1);
+      this->has_count = 0;
+      this->count = 0;
+      this->ms = 0;
+      this->seq = 0;
+      this->total = 0;
+      this->rate = 0;
+      break;
+
+   case setup_rmcios:  // 0=idnum | 1=reset
+      if (this == NULL)
+         break;
+      if (num_params < 1)
+         break;
+      this->device =
+         lj12_device_get (param_to_int (context, paramtype, param, 0));
+      struct lj12_unit *unit = lj12_device_lock (this->device);
+      this->has_count = 0;
+      ljseq_write_begin (&this->seq);
+      this->total = 0;
+      this->rate = 0;
+      ljseq_write_end (&this->seq);
+      if (num_params > 1 && param_to_int (context, paramtype, param, 1) != 0)
+      {
+         long idnum = lj12_unit_id (unit);
+         long err = ECount (&idnum, 0, 1, &this->count, &this->ms);
+         lj12_device_check (this->device, err);
+         if (err == 0)
+         {
+            // Returned count is from before the reset
+            this->count = 0;
+            this->has_count = 1;
+         }
+      }
+      lj12_unit_unlock (unit);
+      break;
+
+   case write_rmcios:
+      if (this == NULL)
+         break;
+      {
+         double count;
+         double ms;
+         char values[64];
+         long err;
+         long idnum;
+         struct lj12_unit *unit = lj12_device_lock (this->device);
+         idnum = lj12_unit_id (unit);
+         err = ECount (&idnum, 0, 0, &count, &ms);
+         lj12_device_check (this->device, err);
+         if (err != 0)
+         {
+            lj12_unit_unlock (unit);
+            printf ("ljcnt: ECount error %ld\r\n", err);
+            break;
+         }
+         if (this->has_count)
+         {
+            // Counter is 32 bits wide and wraps around on overflow
+            double delta = count - this->count;
+            if (delta < 0)
+               delta += 4294967296.0;
+            ljseq_write_begin (&this->seq);
+            this->total += delta;
+            if (ms > this->ms)
+               this->rate = delta * 1000.0 / (ms - this->ms);
+            ljseq_write_end (&this->seq);
+         }
+         this->count = count;
+         this->ms = ms;
+         this->has_count = 1;
+
+         // Total exceeds float precision, so it is sent as text
+         snprintf (values, sizeof (values), "%.9g %.0f",
+                   this->rate, this->total);
+         lj12_unit_unlock (unit);
+         write_str (context, linked_channels (context, id), values, 0);
+      }
+      break;
+
+   case read_rmcios:
+      if (this == NULL)
+         break;
+      if (num_params > 0)
+      {
+         char keyword[20];
+         param_to_string (context, paramtype, param, 0,
+                          sizeof (keyword), keyword);
+         if (strcmp (keyword, "total") == 0)
+         {
+            double total;
+            char text[32];
+            unsigned seq;
+            do
+            {
+               seq = ljseq_read_begin (&this->seq);
+               total = this->total;
+            }
+            while (ljseq_read_retry (&this->seq, seq));
+            snprintf (text, sizeof (text), "%.0f", total);
+            return_string (context, returnv, text);
+            break;
+         }
+      }
+      {
+         double rate;
+         unsigned seq;
+         do
+         {
+            seq = ljseq_read_begin (&this->seq);
+            rate = this->rate;
+         }
+         while (ljseq_read_retry (&this->seq, seq));
+         return_float (context, returnv, (float) rate);
+      }
+      break;
    }
-   else
+}
+
+struct ljpulse_data
+{
+   struct lj12_device *device;
+   long bitselect;      // D0-D7 lines to pulse as bit mask
+   long lowfirst;       // 1 = pulse low first
+   long timeout;        // Finish timeout in ms
+   ljseq_t seq;         // Publishes frequency to readers
+   float frequency;     // Actual frequency of latest train
+};
+
+void labjack_pulse_func (struct ljpulse_data *this,
+                         const struct context_rmcios *context, int id,
+                         enum function_rmcios function,
+                         enum type_rmcios paramtype,
+                         struct combo_rmcios *returnv,
+                         int num_params, const union param_rmcios param)
+{
+   switch (function)
+   {
+   case help_rmcios:
+      return_string (context, returnv,
+                     "help for labjack pulse output. Commands:\r\n"
+                     "create ljpulse ch_name | bitselect\r\n"
+                     "setup ljpulse bitselect(D0-D7 mask) | lowfirst(0)"
+                     " | idnum(-1) | timeout_ms(1000)\r\n"
+                     "write ljpulse frequency | pulses(1)\r\n"
+                     "  #start pulse train on the device. Returns without\r\n"
+                     "  #waiting. Unfinished previous train is finished.\r\n"
+                     "  #Other channels of the device finish the train\r\n"
+                     "  #before their commands.\r\n"
+                     "write ljpulse #finish pulse train and send actual\r\n"
+                     "  #frequency to linked channels\r\n"
+                     "read ljpulse #read actual frequency\r\n");
+      break;
+
+   case create_rmcios:
+      if (num_params < 1)
+      {
+         printf ("Not enough parameters\r\n");
+         break;
+      }
+
+      // allocate new data
+      this = (struct ljpulse_data *) malloc (sizeof (struct ljpulse_data));
+
+      // create channel
+      create_channel_param (context, paramtype, param, 0,
+                            (class_rmcios) labjack_pulse_func, this);
+
+      this->device = lj12_device_get (-1);
+      this->bitselect = 1;
+      this->lowfirst = 0;
+      this->timeout = 1000;
+      this->seq = 0;
+      this->frequency = 0;
+      if (num_params < 2)
+         break;
+      this->bitselect = param_to_int (context, paramtype, param, 1);
+      break;
+
+   case setup_rmcios:  // 0=bitselect | 1=lowfirst | 2=idnum | 3=timeout
+      if (this == NULL)
+         break;
+      if (num_params < 1)
+         break;
+      this->bitselect = param_to_int (context, paramtype, param, 0);
+      if (num_params < 2)
+         break;
+      this->lowfirst = param_to_int (context, paramtype, param, 1);
+      if (num_params < 3)
+         break;
+      this->device =
+         lj12_device_get (param_to_int (context, paramtype, param, 2));
+      if (num_params < 4)
+         break;
+      this->timeout = param_to_int (context, paramtype, param, 3);
+      break;
+
+   case write_rmcios:
+      if (this == NULL)
+         break;
+      if (num_params < 1)       // Finish the running train
+      {
+         int finished = 0;
+         float frequency;
+         struct lj12_unit *unit = lj12_device_lock (this->device);
+         // Only a successfully finished train of this channel is sent.
+         // A train started by another channel replaces the owner.
+         if (unit != NULL && unit->pulse_owner == this)
+         {
+            finished = unit->pulse_err == 0;
+            unit->pulse_owner = NULL;
+            unit->pulse_err = 0;
+         }
+         frequency = this->frequency;
+         lj12_unit_unlock (unit);
+         if (finished)
+            write_f (context, linked_channels (context, id), frequency);
+         break;
+      }
+      {
+         long timeB;
+         long timeC;
+         long pulses = 1;
+         long err;
+         float frequency = param_to_float (context, paramtype, param, 0);
+         if (num_params > 1)
+            pulses = param_to_int (context, paramtype, param, 1);
+
+         struct lj12_unit *unit = lj12_device_lock (this->device);
+
+         // Same timing for both halves of the pulse
+         err = PulseOutCalc (&frequency, &timeB, &timeC);
+         if (err != 0)
+         {
+            lj12_unit_unlock (unit);
+            printf ("ljpulse: PulseOutCalc error %ld\r\n", err);
+            break;
+         }
+         long idnum = lj12_unit_id (unit);
+         err = PulseOutStart (&idnum, 0, this->lowfirst,
+                              this->bitselect, pulses,
+                              timeB, timeC, timeB, timeC);
+         lj12_device_check (this->device, err);
+         if (err == 0)
+         {
+            ljseq_write_begin (&this->seq);
+            this->frequency = frequency;
+            ljseq_write_end (&this->seq);
+            if (unit != NULL)
+            {
+               unit->pulse_running = 1;
+               unit->pulse_timeout = this->timeout;
+               unit->pulse_owner = this;
+               unit->pulse_err = 0;
+            }
+         }
+         lj12_unit_unlock (unit);
+         if (err != 0)
+            printf ("ljpulse: PulseOutStart error %ld\r\n", err);
+      }
+      break;
+
+   case read_rmcios:
+      if (this == NULL)
+         break;
+      {
+         float frequency;
+         unsigned seq;
+         do
+         {
+            seq = ljseq_read_begin (&this->seq);
+            frequency = this->frequency;
+         }
+         while (ljseq_read_retry (&this->seq, seq));
+         return_float (context, returnv, frequency);
+      }
+      break;
+   }
+}
+
+// Driver backend behind the entry points
+static struct lj12_backend lj12_driver;
+
+static void lj12_backend_use (struct lj12_backend *backend)
+{
+   lj12_driver = *backend;
+   // Driver calls go through trace wrappers
+   lj12_trace_install (&lj12_driver);
+
+   // Devices are resolved again from the new backend
+   lj12_device_reset ();
+}
+
+// Channel for selecting driver backend
+void labjack_backend_func (void *this,
+                           const struct context_rmcios *context, int id,
+                           enum function_rmcios function,
+                           enum type_rmcios paramtype,
+                           struct combo_rmcios *returnv,
+                           int num_params, const union param_rmcios param)
+{
+   switch (function)
+   {
+   case help_rmcios:
+      return_string (context, returnv,
+                     "labjack u12 driver backend channel\r\n"
+                     " setup ljbackend vendor #Use vendor driver library\r\n"
+                     " setup ljbackend simulator | latency(0.02) "
+                     "| jitter(0.002)\r\n"
+                     "   | amplitude(1) | frequency(0.1) | noise(0.01)\r\n"
+                     "   #Use simulated U12. Latency and jitter in seconds\r\n"
+                     "   #AI channels are sine waves of amplitude volts.\r\n"
+                     "   #DI channels are square waves.\r\n"
+                     " read ljbackend #read name of the backend\r\n");
+      break;
+
+   case setup_rmcios:
+      if (num_params < 1)
+         break;
+      {
+         struct lj12_backend backend;
+         char name[20];
+         param_to_string (context, paramtype, param, 0, sizeof (name), name);
+         if (strcmp (name, "vendor") == 0)
+         {
+            if (lj12_backend_vendor (&backend) != 0)
+            {
+               printf ("Failed to load %s\r\n", backend.name);
+               break;
+            }
+         }
+         else if (strcmp (name, "simulator") == 0)
+         {
+            double latency = 0.02;
+            double jitter = 0.002;
+            double amplitude = 1;
+            double frequency = 0.1;
+            double noise = 0.01;
+            if (num_params > 1)
+               latency = param_to_float (context, paramtype, param, 1);
+            if (num_params > 2)
+               jitter = param_to_float (context, paramtype, param, 2);
+            if (num_params > 3)
+               amplitude = param_to_float (context, paramtype, param, 3);
+            if (num_params > 4)
+               frequency = param_to_float (context, paramtype, param, 4);
+            if (num_params > 5)
+               noise = param_to_float (context, paramtype, param, 5);
+            lj12sim_configure (latency, jitter, amplitude, frequency, noise);
+            lj12_backend_simulator (&backend);
+         }
+         else
+         {
+            printf ("labjack: Unknown backend %s\r\n", name);
+            break;
+         }
+         lj12_backend_use (&backend);
+      }
+      break;
+
+   case read_rmcios:
+      return_string (context, returnv, lj12_driver.name);
+      break;
+
+   default:
+      break;
+   }
+}
+
+void API_ENTRY_FUNC init_channels (const struct context_rmcios *context)
+{
+   struct lj12_backend backend;
+   printf ("Labjack u12 module\r\n[" VERSION_STR "]\r\n");
+   lj12_device_init ();
+   lj12sim_init ();
+   ljtrace_init ();
+   if (lj12_backend_vendor (&backend) != 0)
    {
-      printf ("Failed to load ljackuw.DLL\t\n");
+      printf ("Failed to load %s. Only simulator and trace replay "
+              "available\r\n", backend.name);
    }
+   lj12_backend_use (&backend);
+
+   create_channel_str (context, "ljai", (class_rmcios)labjack_ai_func, NULL);
+   create_channel_str (context, "ljao", (class_rmcios)labjack_ao_func, NULL);
+   create_channel_str (context, "ljdo", (class_rmcios)labjack_do_func, NULL);
+   create_channel_str (context, "ljdi", (class_rmcios)labjack_di_func, NULL);
+   create_channel_str (context, "ljcnt", (class_rmcios)labjack_counter_func,
+                       NULL);
+   create_channel_str (context, "ljpulse", (class_rmcios)labjack_pulse_func,
+                       NULL);
+   create_channel_str (context, "ljconv", (class_rmcios)ljconv_func, NULL);
+   create_channel_str (context, "ljspool", (class_rmcios)ljspool_func, NULL);
+   create_channel_str (context, "ljtrig", (class_rmcios)ljtrig_func, NULL);
+   create_channel_str (context, "ljtrace", (class_rmcios)ljtrace_func, NULL);
+   create_channel_str (context, "ljbackend",
+                       (class_rmcios)labjack_backend_func, NULL);
 }
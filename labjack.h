@@ -5,11 +5,15 @@
 #ifndef labjack_h
 #define labjack_h
 
+#ifdef _WIN32
 #include <wtypes.h>
+#else
+#define CALLBACK
+#endif
 
 typedef long (CALLBACK *tEAnalogIn)(long*,long,long,long,long*,float*);
 typedef long (CALLBACK *tEAnalogOut)(long*,long,float,float);
-typedef long (CALLBACK *tECount)(long*,long,double*);
+typedef long (CALLBACK *tECount)(long*,long,long,double*,double*);
 typedef long (CALLBACK *tEDigitalIn)(long*,long,long,long,long*);
 typedef long (CALLBACK *tEDigitalOut)(long*,long,long,long,long);
 typedef long (CALLBACK *tAISample)(long*,long,long*,long,long,long,long*,long*,long,long*,float*);
@@ -35,7 +39,6 @@ typedef long (CALLBACK *tPulseOut)(long*,long,long,long,long,long,long,long,long
 typedef long (CALLBACK *tPulseOutStart)(long*,long,long,long,long,long,long,long,long);
 typedef long (CALLBACK *tPulseOutCalc)(float*,long*,long*);
 typedef long (CALLBACK *tPulseOutFinish)(long*,long,long);
-typedef long (CALLBACK *tPulseOutCalc)(float*,long*,long*);
 typedef long (CALLBACK *tReEnum)(long*);
 typedef long (CALLBACK *tReset)(long*) ;
 
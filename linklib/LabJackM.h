@@ -7,6 +7,7 @@
 #endif
 
 #define LJM_STRING_ALLOCATION_SIZE 50
+#define LJM_MAX_NAME_SIZE          256
 #define LJM_UINT16                 0
 #define LJM_UINT32                 1
 #define LJM_INT32                  2
@@ -23,6 +24,7 @@ int CONV LJM_eReadAddress(int, int, int, double *);
 int CONV LJM_eWriteAddress(int, int, int, double);
 int CONV LJM_eReadAddressArray(int, int, int,	int , double *, int *);
 int CONV LJM_eWriteAddressArray(int, int, int, int, const double *, int *);
+int CONV LJM_eReadAddresses(int, int, const int *, const int *, double *, int *);
 int CONV LJM_eReadAddressByteArray(int, int, int, char *, int *);
 int CONV LJM_eWriteAddressByteArray(int, int, int , const char *, int *);
 
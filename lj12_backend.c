@@ -0,0 +1,75 @@
+/*
+RMCIOS - Reactive Multipurpose Control Input Output System
+Copyright (c) 2018 Frans Korhonen
+
+RMIOS was originally developed at Institute for Atmospheric
+and Earth System Research / Physics, Faculty of Science,
+University of Helsinki, Finland
+
+Assistance, experience and feedback from following persons have been
+critical for development of RMCIOS: Erkki Siivola, Juha Kangasluoma,
+Lauri Ahonen, Ella Häkkinen, Pasi Aalto, Joonas Enroth, Runlong Cai,
+Markku Kulmala and Tuukka Petäjä.
+
+This file is extension to RMCIOS. This notice was encoded using utf-8.
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+/**
+ * Vendor library backend for U12 driver entry points.
+ */
+
+#include <string.h>
+#include "lj12_backend.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#define LJ12_LIBRARY "ljackuw.dll"
+#define LOAD_LIBRARY(name) LoadLibrary (name)
+#define LOAD_SYMBOL(library, name) GetProcAddress (library, name)
+typedef HINSTANCE library_t;
+#else
+#include <dlfcn.h>
+#define LJ12_LIBRARY "libljacklm.so"
+#define LOAD_LIBRARY(name) dlopen (name, RTLD_NOW)
+#define LOAD_SYMBOL(library, name) dlsym (library, name)
+typedef void *library_t;
+#endif
+
+static library_t hDLLInstance = NULL;
+
+int lj12_backend_vendor (struct lj12_backend *backend)
+{
+   memset (backend, 0, sizeof (struct lj12_backend));
+   backend->name = LJ12_LIBRARY;
+
+   //Now try and load the library.
+   if (hDLLInstance == NULL)
+      hDLLInstance = LOAD_LIBRARY (LJ12_LIBRARY);
+   if (hDLLInstance == NULL)
+      return -1;
+
+   //If successfully loaded, get the address of the desired functions.
+   backend->EAnalogIn =
+      (tEAnalogIn) LOAD_SYMBOL (hDLLInstance, "EAnalogIn");
+   backend->EAnalogOut =
+      (tEAnalogOut) LOAD_SYMBOL (hDLLInstance, "EAnalogOut");
+   backend->EDigitalOut =
+      (tEDigitalOut) LOAD_SYMBOL (hDLLInstance, "EDigitalOut");
+   backend->EDigitalIn =
+      (tEDigitalIn) LOAD_SYMBOL (hDLLInstance, "EDigitalIn");
+   backend->ECount = (tECount) LOAD_SYMBOL (hDLLInstance, "ECount");
+   backend->PulseOutStart =
+      (tPulseOutStart) LOAD_SYMBOL (hDLLInstance, "PulseOutStart");
+   backend->PulseOutFinish =
+      (tPulseOutFinish) LOAD_SYMBOL (hDLLInstance, "PulseOutFinish");
+   backend->PulseOutCalc =
+      (tPulseOutCalc) LOAD_SYMBOL (hDLLInstance, "PulseOutCalc");
+   backend->ListAll = (tListAll) LOAD_SYMBOL (hDLLInstance, "ListAll");
+   //AISample = (tAISample) GetProcAddress(hDLLInstance,"AISample");
+   return 0;
+}
+
@@ -0,0 +1,40 @@
+/*
+ U12 driver backends. A backend is a table of driver entry points
+ loaded from the vendor library or provided by the built-in simulator.
+*/
+
+#ifndef lj12_backend_h
+#define lj12_backend_h
+
+#include "labjack.h"
+
+struct lj12_backend
+{
+   const char *name;
+   tEAnalogIn EAnalogIn;
+   tEAnalogOut EAnalogOut;
+   tEDigitalIn EDigitalIn;
+   tEDigitalOut EDigitalOut;
+   tECount ECount;
+   tPulseOutStart PulseOutStart;
+   tPulseOutFinish PulseOutFinish;
+   tPulseOutCalc PulseOutCalc;
+   tListAll ListAll;
+};
+
+// Load entry points from vendor library (ljackuw.dll on windows,
+// libljacklm.so elsewhere). Returns 0 on success.
+int lj12_backend_vendor (struct lj12_backend *backend);
+
+// Fill backend with simulator entry points
+void lj12_backend_simulator (struct lj12_backend *backend);
+
+// Initialize simulator state. Call once before other simulator functions.
+void lj12sim_init (void);
+
+// Configure simulator model. Latencies in seconds, signal in volts/Hz.
+void lj12sim_configure (double latency, double jitter,
+                        double amplitude, double frequency, double noise);
+
+#endif
+
@@ -0,0 +1,214 @@
+/*
+RMCIOS - Reactive Multipurpose Control Input Output System
+Copyright (c) 2018 Frans Korhonen
+
+RMIOS was originally developed at Institute for Atmospheric
+and Earth System Research / Physics, Faculty of Science,
+University of Helsinki, Finland
+
+Assistance, experience and feedback from following persons have been
+critical for development of RMCIOS: Erkki Siivola, Juha Kangasluoma,
+Lauri Ahonen, Ella Häkkinen, Pasi Aalto, Joonas Enroth, Runlong Cai,
+Markku Kulmala and Tuukka Petäjä.
+
+This file is extension to RMCIOS. This notice was encoded using utf-8.
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+/**
+ * U12 device contexts and per device locking.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "lj12_device.h"
+#include "lj12_trace.h"
+
+// Protects device and unit lists and device resolving. Taken before
+// unit locks. Several unit locks are only held under it.
+static ljmutex_t lj12_lock;
+
+static struct lj12_unit *first_u12_unit = NULL;
+static struct lj12_device *first_u12_device = NULL;
+
+// Get unit for serial number. Called with lj12_lock held.
+static struct lj12_unit *lj12_unit_get (long serial)
+{
+   struct lj12_unit *unit = first_u12_unit;
+   while (unit != NULL)
+   {
+      if (unit->serial == serial)
+         return unit;
+      unit = unit->next_unit;
+   }
+   unit = (struct lj12_unit *) malloc (sizeof (struct lj12_unit));
+   if (unit == NULL)
+      return NULL;
+   unit->serial = serial;
+   unit->pulse_running = 0;
+   unit->pulse_timeout = 0;
+   unit->pulse_owner = NULL;
+   unit->pulse_err = 0;
+   ljmutex_init (&unit->lock);
+   unit->next_unit = first_u12_unit;
+   first_u12_unit = unit;
+   return unit;
+}
+
+// Finish pulse train started on unit. Result is left to pulse_err.
+// Called with unit lock held.
+static void lj12_unit_finish (struct lj12_unit *unit,
+                              struct lj12_device *device)
+{
+   long idnum = unit->serial;
+   if (!unit->pulse_running)
+      return;
+   unit->pulse_err = PulseOutFinish (&idnum, 0, unit->pulse_timeout);
+   lj12_device_check (device, unit->pulse_err);
+   if (unit->pulse_err != 0)
+      printf ("labjack: PulseOutFinish error %ld\r\n", unit->pulse_err);
+   unit->pulse_running = 0;
+}
+
+// Resolve requested idnum to serial number of an attached device and
+// attach the context to unit of the serial. Called with lj12_lock held.
+static void lj12_device_resolve (struct lj12_device *device)
+{
+   static long productIDs[127];
+   static long serials[127];
+   static long localIDs[127];
+   static long powers[127];
+   static long calMatrix[127][20];
+   struct lj12_unit *unit;
+   long found = 0;
+   long reserved1 = 0;
+   long reserved2 = 0;
+   long err;
+   int resolved = 0;
+   int i;
+
+   device->idnum = device->requested;
+   __atomic_store_n (&device->resolved, 0, __ATOMIC_RELAXED);
+
+   // ListAll talks to all attached devices, so calls on every unit
+   // wait for it. Running pulse trains would be ended by it.
+   for (unit = first_u12_unit; unit != NULL; unit = unit->next_unit)
+   {
+      ljmutex_lock (&unit->lock);
+      lj12_unit_finish (unit, NULL);
+   }
+   err = ListAll (productIDs, serials, localIDs, powers,
+                  (long **) calMatrix, &found, &reserved1, &reserved2);
+   for (unit = first_u12_unit; unit != NULL; unit = unit->next_unit)
+      ljmutex_unlock (&unit->lock);
+
+   if (err != 0)
+      printf ("labjack: ListAll error %ld\r\n", err);
+   for (i = 0; err == 0 && i < found && i < 127; i++)
+   {
+      if (device->requested == -1
+          || device->requested == localIDs[i]
+          || device->requested == serials[i])
+      {
+         device->idnum = serials[i];
+         resolved = 1;
+         break;
+      }
+   }
+   if (err == 0 && !resolved)
+      printf ("labjack: Could not find U12 with idnum %ld\r\n",
+              device->requested);
+   // Unresolved contexts use unit of the requested idnum
+   device->unit = lj12_unit_get (device->idnum);
+   __atomic_store_n (&device->resolved, resolved, __ATOMIC_RELAXED);
+}
+
+// Get shared device context for idnum. Resolves new devices.
+struct lj12_device *lj12_device_get (long requested)
+{
+   struct lj12_device *device;
+   ljmutex_lock (&lj12_lock);
+   device = first_u12_device;
+   while (device != NULL)
+   {
+      if (device->requested == requested)
+         break;
+      device = device->next_device;
+   }
+
+   if (device == NULL)
+   {
+      device = (struct lj12_device *) malloc (sizeof (struct lj12_device));
+      if (device != NULL)
+      {
+         device->requested = requested;
+         lj12_device_resolve (device);
+         device->next_device = first_u12_device;
+         first_u12_device = device;
+      }
+   }
+   ljmutex_unlock (&lj12_lock);
+   return device;
+}
+
+// Idnum for driver calls on locked unit
+long lj12_unit_id (struct lj12_unit *unit)
+{
+   if (unit == NULL)
+      return -1;
+   return unit->serial;
+}
+
+// Mark device for re-resolving after failed driver call
+// Called with unit lock held, so lj12_lock is not taken here.
+void lj12_device_check (struct lj12_device *device, long err)
+{
+   if (err != 0 && device != NULL)
+      __atomic_store_n (&device->resolved, 0, __ATOMIC_RELAXED);
+}
+
+// Lock physical device of context for driver calls. Unresolved
+// contexts are retried first. Any other command ends a running pulse
+// train on U12, so a started train is finished before returning. The
+// result is left to pulse_err for pulse_owner. Returns the locked unit.
+struct lj12_unit *lj12_device_lock (struct lj12_device *device)
+{
+   struct lj12_unit *unit;
+   if (device == NULL)
+      return NULL;
+   ljmutex_lock (&lj12_lock);
+   if (!__atomic_load_n (&device->resolved, __ATOMIC_RELAXED))
+      lj12_device_resolve (device);
+   unit = device->unit;
+   ljmutex_unlock (&lj12_lock);
+   if (unit == NULL)
+      return NULL;
+
+   ljmutex_lock (&unit->lock);
+   lj12_unit_finish (unit, device);
+   return unit;
+}
+
+void lj12_unit_unlock (struct lj12_unit *unit)
+{
+   if (unit != NULL)
+      ljmutex_unlock (&unit->lock);
+}
+
+void lj12_device_init (void)
+{
+   ljmutex_init (&lj12_lock);
+}
+
+void lj12_device_reset (void)
+{
+   struct lj12_device *device;
+   ljmutex_lock (&lj12_lock);
+   for (device = first_u12_device; device != NULL;
+        device = device->next_device)
+      __atomic_store_n (&device->resolved, 0, __ATOMIC_RELAXED);
+   ljmutex_unlock (&lj12_lock);
+}
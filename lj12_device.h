@@ -0,0 +1,60 @@
+/*
+ U12 device contexts. Channels configured with the same idnum share a
+ device context, and contexts resolved to the same serial number share
+ a unit that serializes driver calls to the physical device. Driver
+ calls go through the entry points installed by lj12_trace_install.
+*/
+
+#ifndef lj12_device_h
+#define lj12_device_h
+
+#include "labjack.h"
+#include "ljthread.h"
+
+// Physical U12 shared by all device contexts resolved to same serial
+struct lj12_unit
+{
+   long serial;         // Serial number or unresolved idnum
+   ljmutex_t lock;      // Serializes driver calls to the device
+   int pulse_running;   // Pulse train started and not yet finished
+   long pulse_timeout;  // Finish timeout of running train in ms
+   void *pulse_owner;   // Channel of latest train until result is taken
+   long pulse_err;      // Result of finishing train of pulse_owner
+   struct lj12_unit *next_unit;
+};
+
+// Device context shared by all channels configured with same idnum
+struct lj12_device
+{
+   long requested;      // Configured idnum: -1, local ID or serial number
+   long idnum;          // Resolved serial number
+   int resolved;
+   struct lj12_unit *unit;
+   struct lj12_device *next_device;
+};
+
+// Initialize device lists. Call once before other functions.
+void lj12_device_init (void);
+
+// Get shared device context for idnum. Resolves new devices.
+struct lj12_device *lj12_device_get (long requested);
+
+// Mark all devices for re-resolving, e.g. after backend change
+void lj12_device_reset (void);
+
+// Mark device for re-resolving after failed driver call
+void lj12_device_check (struct lj12_device *device, long err);
+
+// Lock physical device of context for driver calls. Unresolved
+// contexts are retried first. Any other command ends a running pulse
+// train on U12, so a started train is finished before returning. The
+// result is left to pulse_err for pulse_owner. Returns the locked unit.
+struct lj12_unit *lj12_device_lock (struct lj12_device *device);
+
+// Unlock unit returned by lj12_device_lock
+void lj12_unit_unlock (struct lj12_unit *unit);
+
+// Idnum for driver calls on locked unit
+long lj12_unit_id (struct lj12_unit *unit);
+
+#endif
@@ -0,0 +1,403 @@
+/*
+RMCIOS - Reactive Multipurpose Control Input Output System
+Copyright (c) 2018 Frans Korhonen
+
+RMIOS was originally developed at Institute for Atmospheric
+and Earth System Research / Physics, Faculty of Science,
+University of Helsinki, Finland
+
+Assistance, experience and feedback from following persons have been
+critical for development of RMCIOS: Erkki Siivola, Juha Kangasluoma,
+Lauri Ahonen, Ella Häkkinen, Pasi Aalto, Joonas Enroth, Runlong Cai,
+Markku Kulmala and Tuukka Petäjä.
+
+This file is extension to RMCIOS. This notice was encoded using utf-8.
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+/**
+ * Traced wrappers for U12 driver entry points.
+ */
+
+#include <string.h>
+#include "lj12_trace.h"
+#include "ljtrace.h"
+
+// Entry points of the u12 module
+tEAnalogIn EAnalogIn;
+tEAnalogOut EAnalogOut;
+tEDigitalIn EDigitalIn;
+tEDigitalOut EDigitalOut;
+tECount ECount;
+tPulseOutStart PulseOutStart;
+tPulseOutFinish PulseOutFinish;
+tPulseOutCalc PulseOutCalc;
+tListAll ListAll;
+
+// Driver entry points behind the wrappers
+static tEAnalogIn driver_EAnalogIn;
+static tEAnalogOut driver_EAnalogOut;
+static tEDigitalIn driver_EDigitalIn;
+static tEDigitalOut driver_EDigitalOut;
+static tECount driver_ECount;
+static tPulseOutStart driver_PulseOutStart;
+static tPulseOutFinish driver_PulseOutFinish;
+static tPulseOutCalc driver_PulseOutCalc;
+static tListAll driver_ListAll;
+
+// Start time of call when recording
+#define TRACE_START() \
+   (ljtrace_mode == LJTRACE_RECORD ? ljtrace_begin () : 0)
+
+// Replay call of device idnum and channel or fail if driver entry
+// point is missing
+#define TRACE_REPLAY(call, device, channel, p, data, data_size, driver) \
+   if (ljtrace_mode == LJTRACE_REPLAY) \
+   { \
+      if (ljtrace_next (call, device, channel, &err, \
+                        &p, sizeof (p), data, data_size) < 0) \
+         return LJTRACE_ERROR; \
+      goto replayed; \
+   } \
+   if (driver == NULL) \
+      return LJTRACE_ERROR;
+
+#define TRACE_RECORD(call, device, channel, p, data, data_size) \
+   if (ljtrace_mode == LJTRACE_RECORD) \
+      ljtrace_write (call, device, channel, err, start, \
+                     &p, sizeof (p), data, data_size);
+
+static long CALLBACK trace_EAnalogIn (long *idnum, long demo, long channel,
+                                      long gain, long *overVoltage,
+                                      float *voltage)
+{
+   struct
+   {
+      int32_t idnum_in;
+      int32_t idnum;
+      int32_t channel;
+      int32_t gain;
+      int32_t over_voltage;
+      float voltage;
+   } p;
+   int32_t err;
+   double start;
+
+   TRACE_REPLAY (LJ12T_EANALOGIN, *idnum, channel,
+                 p, NULL, 0, driver_EAnalogIn);
+   p.idnum_in = *idnum;
+   start = TRACE_START ();
+   err = driver_EAnalogIn (idnum, demo, channel, gain, overVoltage, voltage);
+   p.idnum = *idnum;
+   p.channel = channel;
+   p.gain = gain;
+   p.over_voltage = *overVoltage;
+   p.voltage = *voltage;
+   TRACE_RECORD (LJ12T_EANALOGIN, p.idnum_in, p.channel, p, NULL, 0);
+   return err;
+
+ replayed:
+   *idnum = p.idnum;
+   *overVoltage = p.over_voltage;
+   *voltage = p.voltage;
+   return err;
+}
+
+static long CALLBACK trace_EAnalogOut (long *idnum, long demo,
+                                       float analogOut0, float analogOut1)
+{
+   struct
+   {
+      int32_t idnum_in;
+      int32_t idnum;
+      float analog_out0;
+      float analog_out1;
+   } p;
+   int32_t err;
+   double start;
+
+   TRACE_REPLAY (LJ12T_EANALOGOUT, *idnum, 0, p, NULL, 0, driver_EAnalogOut);
+   p.idnum_in = *idnum;
+   start = TRACE_START ();
+   err = driver_EAnalogOut (idnum, demo, analogOut0, analogOut1);
+   p.idnum = *idnum;
+   p.analog_out0 = analogOut0;
+   p.analog_out1 = analogOut1;
+   TRACE_RECORD (LJ12T_EANALOGOUT, p.idnum_in, 0, p, NULL, 0);
+   return err;
+
+ replayed:
+   *idnum = p.idnum;
+   return err;
+}
+
+static long CALLBACK trace_EDigitalIn (long *idnum, long demo, long channel,
+                                       long readD, long *state)
+{
+   struct
+   {
+      int32_t idnum_in;
+      int32_t idnum;
+      int32_t channel;
+      int32_t read_d;
+      int32_t state;
+   } p;
+   int32_t err;
+   double start;
+
+   TRACE_REPLAY (LJ12T_EDIGITALIN, *idnum, channel,
+                 p, NULL, 0, driver_EDigitalIn);
+   p.idnum_in = *idnum;
+   start = TRACE_START ();
+   err = driver_EDigitalIn (idnum, demo, channel, readD, state);
+   p.idnum = *idnum;
+   p.channel = channel;
+   p.read_d = readD;
+   p.state = *state;
+   TRACE_RECORD (LJ12T_EDIGITALIN, p.idnum_in, p.channel, p, NULL, 0);
+   return err;
+
+ replayed:
+   *idnum = p.idnum;
+   *state = p.state;
+   return err;
+}
+
+static long CALLBACK trace_EDigitalOut (long *idnum, long demo, long channel,
+                                        long writeD, long state)
+{
+   struct
+   {
+      int32_t idnum_in;
+      int32_t idnum;
+      int32_t channel;
+      int32_t write_d;
+      int32_t state;
+   } p;
+   int32_t err;
+   double start;
+
+   TRACE_REPLAY (LJ12T_EDIGITALOUT, *idnum, channel,
+                 p, NULL, 0, driver_EDigitalOut);
+   p.idnum_in = *idnum;
+   start = TRACE_START ();
+   err = driver_EDigitalOut (idnum, demo, channel, writeD, state);
+   p.idnum = *idnum;
+   p.channel = channel;
+   p.write_d = writeD;
+   p.state = state;
+   TRACE_RECORD (LJ12T_EDIGITALOUT, p.idnum_in, p.channel, p, NULL, 0);
+   return err;
+
+ replayed:
+   *idnum = p.idnum;
+   return err;
+}
+
+static long CALLBACK trace_ECount (long *idnum, long demo, long resetCounter,
+                                   double *count, double *ms)
+{
+   struct
+   {
+      int32_t idnum_in;
+      int32_t idnum;
+      int32_t reset_counter;
+      int32_t reserved;
+      double count;
+      double ms;
+   } p;
+   int32_t err;
+   double start;
+
+   TRACE_REPLAY (LJ12T_ECOUNT, *idnum, 0, p, NULL, 0, driver_ECount);
+   p.idnum_in = *idnum;
+   start = TRACE_START ();
+   err = driver_ECount (idnum, demo, resetCounter, count, ms);
+   p.idnum = *idnum;
+   p.reset_counter = resetCounter;
+   p.reserved = 0;
+   p.count = *count;
+   p.ms = *ms;
+   TRACE_RECORD (LJ12T_ECOUNT, p.idnum_in, 0, p, NULL, 0);
+   return err;
+
+ replayed:
+   *idnum = p.idnum;
+   *count = p.count;
+   *ms = p.ms;
+   return err;
+}
+
+static long CALLBACK trace_PulseOutStart (long *idnum, long demo,
+                                          long lowFirst, long bitSelect,
+                                          long numPulses,
+                                          long timeB1, long timeC1,
+                                          long timeB2, long timeC2)
+{
+   struct
+   {
+      int32_t idnum_in;
+      int32_t idnum;
+      int32_t low_first;
+      int32_t bit_select;
+      int32_t num_pulses;
+      int32_t time[4];
+   } p;
+   int32_t err;
+   double start;
+
+   TRACE_REPLAY (LJ12T_PULSEOUTSTART, *idnum, 0,
+                 p, NULL, 0, driver_PulseOutStart);
+   p.idnum_in = *idnum;
+   start = TRACE_START ();
+   err = driver_PulseOutStart (idnum, demo, lowFirst, bitSelect, numPulses,
+                               timeB1, timeC1, timeB2, timeC2);
+   p.idnum = *idnum;
+   p.low_first = lowFirst;
+   p.bit_select = bitSelect;
+   p.num_pulses = numPulses;
+   p.time[0] = timeB1;
+   p.time[1] = timeC1;
+   p.time[2] = timeB2;
+   p.time[3] = timeC2;
+   TRACE_RECORD (LJ12T_PULSEOUTSTART, p.idnum_in, 0, p, NULL, 0);
+   return err;
+
+ replayed:
+   *idnum = p.idnum;
+   return err;
+}
+
+static long CALLBACK trace_PulseOutFinish (long *idnum, long demo,
+                                           long timeoutMS)
+{
+   struct
+   {
+      int32_t idnum_in;
+      int32_t idnum;
+      int32_t timeout;
+   } p;
+   int32_t err;
+   double start;
+
+   TRACE_REPLAY (LJ12T_PULSEOUTFINISH, *idnum, 0,
+                 p, NULL, 0, driver_PulseOutFinish);
+   p.idnum_in = *idnum;
+   start = TRACE_START ();
+   err = driver_PulseOutFinish (idnum, demo, timeoutMS);
+   p.idnum = *idnum;
+   p.timeout = timeoutMS;
+   TRACE_RECORD (LJ12T_PULSEOUTFINISH, p.idnum_in, 0, p, NULL, 0);
+   return err;
+
+ replayed:
+   *idnum = p.idnum;
+   return err;
+}
+
+static long CALLBACK trace_PulseOutCalc (float *frequency,
+                                         long *timeB, long *timeC)
+{
+   struct
+   {
+      float frequency_in;
+      float frequency;
+      int32_t time_b;
+      int32_t time_c;
+   } p;
+   int32_t err;
+   double start;
+
+   TRACE_REPLAY (LJ12T_PULSEOUTCALC, LJTRACE_NO_DEVICE, 0,
+                 p, NULL, 0, driver_PulseOutCalc);
+   p.frequency_in = *frequency;
+   start = TRACE_START ();
+   err = driver_PulseOutCalc (frequency, timeB, timeC);
+   p.frequency = *frequency;
+   p.time_b = *timeB;
+   p.time_c = *timeC;
+   TRACE_RECORD (LJ12T_PULSEOUTCALC, LJTRACE_NO_DEVICE, 0, p, NULL, 0);
+   return err;
+
+ replayed:
+   *frequency = p.frequency;
+   *timeB = p.time_b;
+   *timeC = p.time_c;
+   return err;
+}
+
+// Device lists are recorded for found devices. Calibration is not.
+static long CALLBACK trace_ListAll (long *productIDList, long *serialnumList,
+                                    long *localIDList, long *powerList,
+                                    long **calMatrix, long *numberFound,
+                                    long *fcddMaxSize, long *hvcMaxSize)
+{
+   struct
+   {
+      int32_t found;
+   } p;
+   int32_t lists[4][127];
+   int32_t err;
+   double start;
+   int i;
+
+   TRACE_REPLAY (LJ12T_LISTALL, LJTRACE_NO_DEVICE, 0,
+                 p, lists, sizeof (lists), driver_ListAll);
+   start = TRACE_START ();
+   err = driver_ListAll (productIDList, serialnumList, localIDList,
+                         powerList, calMatrix, numberFound,
+                         fcddMaxSize, hvcMaxSize);
+   p.found = *numberFound;
+   if (p.found > 127)
+      p.found = 127;
+   for (i = 0; i < p.found; i++)
+   {
+      lists[0][i] = productIDList[i];
+      lists[1][i] = serialnumList[i];
+      lists[2][i] = localIDList[i];
+      lists[3][i] = powerList[i];
+   }
+   for (; i < 127; i++)
+      lists[0][i] = lists[1][i] = lists[2][i] = lists[3][i] = 0;
+   TRACE_RECORD (LJ12T_LISTALL, LJTRACE_NO_DEVICE, 0,
+                 p, lists, sizeof (lists));
+   return err;
+
+ replayed:
+   *numberFound = p.found;
+   for (i = 0; i < p.found && i < 127; i++)
+   {
+      productIDList[i] = lists[0][i];
+      serialnumList[i] = lists[1][i];
+      localIDList[i] = lists[2][i];
+      powerList[i] = lists[3][i];
+   }
+   return err;
+}
+
+void lj12_trace_install (const struct lj12_backend *driver)
+{
+   driver_EAnalogIn = driver->EAnalogIn;
+   driver_EAnalogOut = driver->EAnalogOut;
+   driver_EDigitalIn = driver->EDigitalIn;
+   driver_EDigitalOut = driver->EDigitalOut;
+   driver_ECount = driver->ECount;
+   driver_PulseOutStart = driver->PulseOutStart;
+   driver_PulseOutFinish = driver->PulseOutFinish;
+   driver_PulseOutCalc = driver->PulseOutCalc;
+   driver_ListAll = driver->ListAll;
+
+   EAnalogIn = trace_EAnalogIn;
+   EAnalogOut = trace_EAnalogOut;
+   EDigitalIn = trace_EDigitalIn;
+   EDigitalOut = trace_EDigitalOut;
+   ECount = trace_ECount;
+   PulseOutStart = trace_PulseOutStart;
+   PulseOutFinish = trace_PulseOutFinish;
+   PulseOutCalc = trace_PulseOutCalc;
+   ListAll = trace_ListAll;
+}
+
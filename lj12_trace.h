@@ -0,0 +1,43 @@
+/*
+ Traced U12 driver entry points. lj12_trace_install points the entry
+ points of the u12 module to wrappers that call the backend driver
+ when tracing is off, record the calls when recording and return
+ recorded results on replay.
+*/
+
+#ifndef lj12_trace_h
+#define lj12_trace_h
+
+#include "labjack.h"
+#include "lj12_backend.h"
+
+enum lj12_trace_call
+{
+   LJ12T_EANALOGIN = 101,
+   LJ12T_EANALOGOUT,
+   LJ12T_EDIGITALIN,
+   LJ12T_EDIGITALOUT,
+   LJ12T_ECOUNT,
+   LJ12T_PULSEOUTSTART,
+   LJ12T_PULSEOUTFINISH,
+   LJ12T_PULSEOUTCALC,
+   LJ12T_LISTALL
+};
+
+// Entry points of the u12 module
+extern tEAnalogIn EAnalogIn;
+extern tEAnalogOut EAnalogOut;
+extern tEDigitalIn EDigitalIn;
+extern tEDigitalOut EDigitalOut;
+extern tECount ECount;
+extern tPulseOutStart PulseOutStart;
+extern tPulseOutFinish PulseOutFinish;
+extern tPulseOutCalc PulseOutCalc;
+extern tListAll ListAll;
+
+// Route entry points through trace wrappers to driver backend.
+// Entry points the backend is missing fail unless replayed.
+void lj12_trace_install (const struct lj12_backend *driver);
+
+#endif
+
@@ -0,0 +1,184 @@
+/*
+RMCIOS - Reactive Multipurpose Control Input Output System
+Copyright (c) 2018 Frans Korhonen
+
+RMIOS was originally developed at Institute for Atmospheric
+and Earth System Research / Physics, Faculty of Science,
+University of Helsinki, Finland
+
+Assistance, experience and feedback from following persons have been
+critical for development of RMCIOS: Erkki Siivola, Juha Kangasluoma,
+Lauri Ahonen, Ella Häkkinen, Pasi Aalto, Joonas Enroth, Runlong Cai,
+Markku Kulmala and Tuukka Petäjä.
+
+This file is extension to RMCIOS. This notice was encoded using utf-8.
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+/**
+ * Throughput and latency benchmark of the U12 driver calls behind the
+ * ljai, ljao, ljdi and ljdo channels. It measures driver latency only:
+ * each call goes through the installed entry points, the trace wrapper
+ * and the device lock, but not through the channel functions, so
+ * channel overhead such as conversion, adaptive polling and linked
+ * channels is not included. Runs against the simulator backend, or the
+ * vendor library with -vendor.
+ *
+ * Usage: lj12bench | -vendor | calls(1000) | latency(0.02) | jitter(0.002)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lj12_backend.h"
+#include "lj12_trace.h"
+#include "lj12_device.h"
+#include "ljtrace.h"
+#include "ljtime.h"
+
+enum bench_call
+{
+   BENCH_AI,
+   BENCH_AO,
+   BENCH_DI,
+   BENCH_DO
+};
+
+static const char *bench_names[] = {
+   "EAnalogIn", "EAnalogOut", "EDigitalIn", "EDigitalOut"
+};
+
+static int compare_double (const void *a, const void *b)
+{
+   double x = *(const double *) a;
+   double y = *(const double *) b;
+   return (x > y) - (x < y);
+}
+
+// Call driver with the locking of a channel write. Returns driver error.
+static long bench_call (struct lj12_device *device, enum bench_call call,
+                        int i)
+{
+   struct lj12_unit *unit = lj12_device_lock (device);
+   long idnum = lj12_unit_id (unit);
+   long state = 0;
+   long overVoltage;
+   float voltage;
+   long err = -1;
+
+   switch (call)
+   {
+   case BENCH_AI:
+      err = EAnalogIn (&idnum, 0, 0, 0, &overVoltage, &voltage);
+      break;
+   case BENCH_AO:
+      err = EAnalogOut (&idnum, 0, (float) (i & 1), -1.0);
+      break;
+   case BENCH_DI:
+      err = EDigitalIn (&idnum, 0, 0, 0, &state);
+      break;
+   case BENCH_DO:
+      err = EDigitalOut (&idnum, 0, 0, 0, i & 1);
+      break;
+   }
+   lj12_device_check (device, err);
+   lj12_unit_unlock (unit);
+   return err;
+}
+
+static void bench_run (struct lj12_device *device, enum bench_call call,
+                       double *latencies, int calls)
+{
+   double start;
+   double end;
+   double sum = 0;
+   int errors = 0;
+   int i;
+
+   start = ljtime_monotonic ();
+   for (i = 0; i < calls; i++)
+   {
+      double t = ljtime_monotonic ();
+      if (bench_call (device, call, i) != 0)
+         errors++;
+      latencies[i] = ljtime_monotonic () - t;
+      sum += latencies[i];
+   }
+   end = ljtime_monotonic ();
+
+   qsort (latencies, calls, sizeof (double), compare_double);
+   printf ("%-11s %10.1f %10.3f %10.3f %10.3f %10.3f %6d\n",
+           bench_names[call], calls / (end - start),
+           sum / calls * 1e3,
+           latencies[calls / 2] * 1e3,
+           latencies[(int) (calls * 0.99)] * 1e3,
+           latencies[calls - 1] * 1e3, errors);
+}
+
+int main (int argc, char *argv[])
+{
+   struct lj12_backend driver;
+   struct lj12_device *device;
+   double *latencies;
+   double latency = 0.02;
+   double jitter = 0.002;
+   int calls = 1000;
+   int vendor = 0;
+   int arg = 1;
+   int call;
+
+   if (arg < argc && strcmp (argv[arg], "-vendor") == 0)
+   {
+      vendor = 1;
+      arg++;
+   }
+   if (arg < argc)
+      calls = atoi (argv[arg++]);
+   if (arg < argc)
+      latency = atof (argv[arg++]);
+   if (arg < argc)
+      jitter = atof (argv[arg++]);
+   if (calls < 1)
+   {
+      printf ("Usage: %s | -vendor | calls | latency | jitter\n", argv[0]);
+      return 1;
+   }
+
+   lj12_device_init ();
+   lj12sim_init ();
+   ljtrace_init ();
+   if (vendor)
+   {
+      if (lj12_backend_vendor (&driver) != 0)
+      {
+         printf ("Failed to load %s\n", driver.name);
+         return 1;
+      }
+   }
+   else
+   {
+      lj12sim_configure (latency, jitter, 1, 0.1, 0.01);
+      lj12_backend_simulator (&driver);
+   }
+   lj12_trace_install (&driver);
+   device = lj12_device_get (-1);
+
+   latencies = (double *) malloc (calls * sizeof (double));
+   if (latencies == NULL)
+      return 1;
+
+   printf ("backend %s, %d calls, driver latency only\n",
+           driver.name, calls);
+   printf ("%-11s %10s %10s %10s %10s %10s %6s\n",
+           "call", "calls/s", "mean(ms)", "p50(ms)", "p99(ms)", "max(ms)",
+           "errors");
+   for (call = BENCH_AI; call <= BENCH_DO; call++)
+      bench_run (device, (enum bench_call) call, latencies, calls);
+
+   free (latencies);
+   return 0;
+}
+
@@ -0,0 +1,294 @@
+/*
+RMCIOS - Reactive Multipurpose Control Input Output System
+Copyright (c) 2018 Frans Korhonen
+
+RMIOS was originally developed at Institute for Atmospheric
+and Earth System Research / Physics, Faculty of Science,
+University of Helsinki, Finland
+
+Assistance, experience and feedback from following persons have been
+critical for development of RMCIOS: Erkki Siivola, Juha Kangasluoma,
+Lauri Ahonen, Ella Häkkinen, Pasi Aalto, Joonas Enroth, Runlong Cai,
+Markku Kulmala and Tuukka Petäjä.
+
+This file is extension to RMCIOS. This notice was encoded using utf-8.
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+/**
+ * Simulated U12 driver backend. Models a single attached device with
+ * per call latency, sine wave analog inputs with noise, square wave
+ * digital inputs and a free running counter.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lj12_backend.h"
+#include "ljtime.h"
+#include "ljthread.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SIM_SERIAL 100000001
+#define SIM_LOCALID 0
+#define SIM_COUNT_RATE 1000.0   // Counter input frequency (Hz)
+
+static struct
+{
+   double latency;              // Fixed part of call latency (s)
+   double jitter;               // Maximum random extra latency (s)
+   double amplitude;            // Analog input amplitude (V)
+   double frequency;            // Analog and digital signal frequency (Hz)
+   double noise;                // Peak to peak analog input noise (V)
+   double start;                // Time of first call
+   double count_reset;          // Time of last counter reset
+   float frequency_out;         // Last calculated pulse frequency
+   double pulses_end;           // End time of started pulse train
+   long d_state;                // D lines written with EDigitalOut
+   long io_state;               // IO lines written with EDigitalOut
+   long d_written;
+   long io_written;
+   unsigned long random;
+} sim = { 0.02, 0.002, 1.0, 0.1, 0.01 };
+
+// Protects sim state between calling threads
+static ljmutex_t sim_lock;
+
+// Called with sim_lock held
+static double sim_random (void)
+{
+   sim.random = sim.random * 1103515245UL + 12345UL;
+   return ((sim.random >> 16) & 0x7fff) / 32768.0;
+}
+
+// Time since first call. Sleeps the modeled call latency.
+static double sim_call (void)
+{
+   double now = ljtime_monotonic ();
+   double wait;
+   ljmutex_lock (&sim_lock);
+   wait = sim.latency + sim.jitter * sim_random ();
+   if (sim.start == 0)
+      sim.start = sim.count_reset = now;
+   now -= sim.start;
+   ljmutex_unlock (&sim_lock);
+   ljtime_sleep (wait);
+   return now;
+}
+
+// Accept -1, local ID and serial number. Returns serial in idnum.
+static long sim_device (long *idnum)
+{
+   if (*idnum != -1 && *idnum != SIM_LOCALID && *idnum != SIM_SERIAL)
+      return 2;                 // No U12s found
+   *idnum = SIM_SERIAL;
+   return 0;
+}
+
+static long CALLBACK sim_EAnalogIn (long *idnum, long demo, long channel,
+                                    long gain, long *overVoltage,
+                                    float *voltage)
+{
+   double t = sim_call ();
+   double v;
+   if (sim_device (idnum) != 0)
+      return 2;
+   if (channel < 0 || channel > 11)
+      return 10;                // Invalid channel
+   ljmutex_lock (&sim_lock);
+   v = sim.amplitude * sin (2 * M_PI * sim.frequency * t + channel)
+      + sim.noise * (sim_random () - 0.5);
+   ljmutex_unlock (&sim_lock);
+   *overVoltage = (v > 10 || v < -10);
+   *voltage = (float) v;
+   return 0;
+}
+
+static long CALLBACK sim_EAnalogOut (long *idnum, long demo,
+                                     float analogOut0, float analogOut1)
+{
+   sim_call ();
+   if (sim_device (idnum) != 0)
+      return 2;
+   // Negative voltage leaves the output unchanged
+   if (analogOut0 > 5 || analogOut1 > 5)
+      return 40;                // Illegal voltage
+   return 0;
+}
+
+static long CALLBACK sim_EDigitalIn (long *idnum, long demo, long channel,
+                                     long readD, long *state)
+{
+   double t = sim_call ();
+   long mask;
+   if (sim_device (idnum) != 0)
+      return 2;
+   if (channel < 0 || channel > (readD ? 15 : 3))
+      return 10;
+   mask = 1L << channel;
+   // Written outputs read back. Others follow square waves.
+   ljmutex_lock (&sim_lock);
+   if ((readD ? sim.d_written : sim.io_written) & mask)
+      *state = ((readD ? sim.d_state : sim.io_state) & mask) != 0;
+   else
+      *state = fmod (sim.frequency * (channel + 1) * t, 1) >= 0.5;
+   ljmutex_unlock (&sim_lock);
+   return 0;
+}
+
+static long CALLBACK sim_EDigitalOut (long *idnum, long demo, long channel,
+                                      long writeD, long state)
+{
+   long mask;
+   sim_call ();
+   if (sim_device (idnum) != 0)
+      return 2;
+   if (channel < 0 || channel > (writeD ? 15 : 3))
+      return 10;
+   mask = 1L << channel;
+   ljmutex_lock (&sim_lock);
+   if (writeD)
+   {
+      sim.d_written |= mask;
+      sim.d_state = state ? sim.d_state | mask : sim.d_state & ~mask;
+   }
+   else
+   {
+      sim.io_written |= mask;
+      sim.io_state = state ? sim.io_state | mask : sim.io_state & ~mask;
+   }
+   ljmutex_unlock (&sim_lock);
+   return 0;
+}
+
+static long CALLBACK sim_ECount (long *idnum, long demo, long resetCounter,
+                                 double *count, double *ms)
+{
+   double t = sim_call ();
+   if (sim_device (idnum) != 0)
+      return 2;
+   ljmutex_lock (&sim_lock);
+   *count = fmod (floor ((sim.start + t - sim.count_reset) * SIM_COUNT_RATE),
+                  4294967296.0);
+   *ms = t * 1000;
+   if (resetCounter)
+      sim.count_reset = sim.start + t;
+   ljmutex_unlock (&sim_lock);
+   return 0;
+}
+
+static long CALLBACK sim_PulseOutCalc (float *frequency, long *timeB,
+                                       long *timeC)
+{
+   // Approximates driver time constants: f = 6e6 / (timeB * timeC)
+   long b;
+   long c;
+   if (*frequency < 6e6 / (255 * 255) || *frequency > 10e3)
+      return 43;                // Invalid frequency
+   for (b = 1; b < 255; b++)
+   {
+      c = (long) (6e6 / (*frequency * b) + 0.5);
+      if (c < 256)
+         break;
+   }
+   if (c < 1)
+      c = 1;
+   if (c > 255)
+      c = 255;
+   *timeB = b;
+   *timeC = c;
+   *frequency = (float) (6e6 / (b * c));
+   ljmutex_lock (&sim_lock);
+   sim.frequency_out = *frequency;
+   ljmutex_unlock (&sim_lock);
+   return 0;
+}
+
+static long CALLBACK sim_PulseOutStart (long *idnum, long demo, long lowFirst,
+                                        long bitSelect, long numPulses,
+                                        long timeB1, long timeC1,
+                                        long timeB2, long timeC2)
+{
+   double t = sim_call ();
+   if (sim_device (idnum) != 0)
+      return 2;
+   if (timeB1 < 1 || timeC1 < 1 || timeB2 < 1 || timeC2 < 1)
+      return 43;
+   // Each phase lasts half of the period 1 / f = timeB * timeC / 6e6
+   ljmutex_lock (&sim_lock);
+   sim.pulses_end = sim.start + t
+      + numPulses * (timeB1 * timeC1 + timeB2 * timeC2) / 12e6;
+   ljmutex_unlock (&sim_lock);
+   return 0;
+}
+
+static long CALLBACK sim_PulseOutFinish (long *idnum, long demo,
+                                         long timeoutMS)
+{
+   double wait;
+   sim_call ();
+   if (sim_device (idnum) != 0)
+      return 2;
+   ljmutex_lock (&sim_lock);
+   wait = sim.pulses_end - ljtime_monotonic ();
+   ljmutex_unlock (&sim_lock);
+   if (wait > timeoutMS / 1000.0)
+   {
+      ljtime_sleep (timeoutMS / 1000.0);
+      return 1;                 // Timeout
+   }
+   ljtime_sleep (wait);
+   return 0;
+}
+
+static long CALLBACK sim_ListAll (long *productIDList, long *serialnumList,
+                                  long *localIDList, long *powerList,
+                                  long **calMatrix, long *numberFound,
+                                  long *fcddMaxSize, long *hvcMaxSize)
+{
+   sim_call ();
+   productIDList[0] = 1;
+   serialnumList[0] = SIM_SERIAL;
+   localIDList[0] = SIM_LOCALID;
+   powerList[0] = 0;
+   *numberFound = 1;
+   return 0;
+}
+
+void lj12sim_init (void)
+{
+   ljmutex_init (&sim_lock);
+}
+
+void lj12sim_configure (double latency, double jitter,
+                        double amplitude, double frequency, double noise)
+{
+   ljmutex_lock (&sim_lock);
+   sim.latency = latency > 0 ? latency : 0;
+   sim.jitter = jitter > 0 ? jitter : 0;
+   sim.amplitude = amplitude;
+   sim.frequency = frequency;
+   sim.noise = noise;
+   ljmutex_unlock (&sim_lock);
+}
+
+void lj12_backend_simulator (struct lj12_backend *backend)
+{
+   backend->name = "simulator";
+   backend->EAnalogIn = sim_EAnalogIn;
+   backend->EAnalogOut = sim_EAnalogOut;
+   backend->EDigitalIn = sim_EDigitalIn;
+   backend->EDigitalOut = sim_EDigitalOut;
+   backend->ECount = sim_ECount;
+   backend->PulseOutStart = sim_PulseOutStart;
+   backend->PulseOutFinish = sim_PulseOutFinish;
+   backend->PulseOutCalc = sim_PulseOutCalc;
+   backend->ListAll = sim_ListAll;
+}
+
@@ -0,0 +1,89 @@
+/*
+RMCIOS - Reactive Multipurpose Control Input Output System
+Copyright (c) 2018 Frans Korhonen
+
+RMIOS was originally developed at Institute for Atmospheric
+and Earth System Research / Physics, Faculty of Science,
+University of Helsinki, Finland
+
+Assistance, experience and feedback from following persons have been
+critical for development of RMCIOS: Erkki Siivola, Juha Kangasluoma,
+Lauri Ahonen, Ella Häkkinen, Pasi Aalto, Joonas Enroth, Runlong Cai,
+Markku Kulmala and Tuukka Petäjä.
+
+This file is extension to RMCIOS. This notice was encoded using utf-8.
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+/**
+ * Activity driven poll scheduling shared by the labjack modules.
+ */
+
+#include <string.h>
+#include <math.h>
+#include "ljadapt.h"
+
+void ljadapt_init (struct ljadapt_data *adapt)
+{
+   memset (adapt, 0, sizeof (struct ljadapt_data));
+   adapt->enabled = 0;
+}
+
+void ljadapt_setup (struct ljadapt_data *adapt, double min_interval,
+                    double max_interval, double deadband)
+{
+   if (min_interval < 1e-3)
+      min_interval = 1e-3;
+   if (max_interval < min_interval)
+      max_interval = min_interval;
+   adapt->min_interval = min_interval;
+   adapt->max_interval = max_interval;
+   adapt->deadband = deadband;
+   adapt->interval = min_interval;
+   adapt->next_poll = 0;
+   adapt->has_value = 0;
+   adapt->enabled = 1;
+}
+
+int ljadapt_due (const struct ljadapt_data *adapt, double now)
+{
+   if (!adapt->enabled || !adapt->has_value)
+      return 1;
+   return now >= adapt->next_poll;
+}
+
+void ljadapt_skip (struct ljadapt_data *adapt)
+{
+   adapt->skipped++;
+   adapt->saved_time += adapt->call_time;
+}
+
+void ljadapt_update (struct ljadapt_data *adapt, double value,
+                     double now, double duration)
+{
+   // Exponential average of bus call duration
+   if (adapt->polls == 0)
+      adapt->call_time = duration;
+   else
+      adapt->call_time += (duration - adapt->call_time) * 0.1;
+   adapt->polls++;
+
+   if (!adapt->enabled)
+      return;
+   if (!adapt->has_value || fabs (value - adapt->last_value) > adapt->deadband)
+      adapt->interval = adapt->min_interval;    // Active
+   else
+   {
+      // Stable: back off towards the floor rate
+      adapt->interval *= 2;
+      if (adapt->interval > adapt->max_interval)
+         adapt->interval = adapt->max_interval;
+   }
+   adapt->last_value = value;
+   adapt->has_value = 1;
+   adapt->next_poll = now + adapt->interval;
+}
+
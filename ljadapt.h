@@ -0,0 +1,44 @@
+/*
+ Adaptive polling rate for labjack channels. A channel is polled at the
+ minimum interval while its value changes and the interval is doubled
+ up to the maximum interval while the value stays within a deadband.
+*/
+
+#ifndef ljadapt_h
+#define ljadapt_h
+
+struct ljadapt_data
+{
+   int enabled;
+   double min_interval;         // Seconds between polls when active
+   double max_interval;         // Seconds between polls when stable
+   double deadband;             // Change that counts as activity
+   double interval;             // Current poll interval
+   double next_poll;            // Monotonic time of next due poll
+   double last_value;
+   int has_value;
+   double call_time;            // Average duration of one bus call
+   unsigned long polls;         // Bus calls made
+   unsigned long skipped;       // Bus calls skipped
+   double saved_time;           // Estimated bus time saved in seconds
+};
+
+// Set default disabled state
+void ljadapt_init (struct ljadapt_data *adapt);
+
+// Enable adaptive polling with given bounds
+void ljadapt_setup (struct ljadapt_data *adapt, double min_interval,
+                    double max_interval, double deadband);
+
+// Returns nonzero when the bus should be polled now
+int ljadapt_due (const struct ljadapt_data *adapt, double now);
+
+// Account a poll that was not due as saved bus time
+void ljadapt_skip (struct ljadapt_data *adapt);
+
+// Update poll interval after a bus call that took duration seconds
+void ljadapt_update (struct ljadapt_data *adapt, double value,
+                     double now, double duration);
+
+#endif
+
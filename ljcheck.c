@@ -0,0 +1,381 @@
+/*
+RMCIOS - Reactive Multipurpose Control Input Output System
+Copyright (c) 2018 Frans Korhonen
+
+RMIOS was originally developed at Institute for Atmospheric
+and Earth System Research / Physics, Faculty of Science,
+University of Helsinki, Finland
+
+Assistance, experience and feedback from following persons have been
+critical for development of RMCIOS: Erkki Siivola, Juha Kangasluoma,
+Lauri Ahonen, Ella Häkkinen, Pasi Aalto, Joonas Enroth, Runlong Cai,
+Markku Kulmala and Tuukka Petäjä.
+
+This file is extension to RMCIOS. This notice was encoded using utf-8.
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+/**
+ * Host side checks of conversion, trigger and spool logic that run
+ * without hardware: NIST ITS-90 type K reference points, cold junction
+ * compensation, RTD, table interpolation, trigger pre/post indexing and
+ * spool segment round trip with rotation.
+ *
+ * Usage: ljcheck
+ * Spool segments are created as ljcheck_spool_NNNNNN.ljs in the working
+ * directory and removed afterwards.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "RMCIOS-functions.h"
+#include "ljtrig.h"
+
+// Spool internals are included so segments can be set up without
+// a running RMCIOS context.
+#include "ljspool.c"
+
+// Capture snapshots the trigger sends to linked channels
+static int emitted_count;
+static float emitted[64];
+
+// Trigger the linked channel pushes feedback sample to once
+static struct ljtrig_data *feedback_trigger;
+static double feedback_value;
+
+static int check_linked_channels (const struct context_rmcios *context,
+                                  int id)
+{
+   return id;
+}
+
+static void check_write_fv (const struct context_rmcios *context, int id,
+                            int num_values, const float *values)
+{
+   struct ljtrig_data *trig = feedback_trigger;
+   if (num_values > (int) (sizeof (emitted) / sizeof (emitted[0])))
+      num_values = sizeof (emitted) / sizeof (emitted[0]);
+   memcpy (emitted, values, num_values * sizeof (float));
+   emitted_count = num_values;
+   if (trig != NULL)
+   {
+      feedback_trigger = NULL;
+      ljtrig_push (trig, context, &feedback_value, 1);
+   }
+}
+
+// Trigger logic is included so snapshots can be captured without
+// a running RMCIOS context.
+#define linked_channels check_linked_channels
+#define write_fv check_write_fv
+#include "ljtrig.c"
+#undef linked_channels
+#undef write_fv
+
+#include "ljconv.h"
+
+static int failures = 0;
+
+static void check (int ok, const char *what)
+{
+   if (!ok)
+   {
+      printf ("FAIL: %s\n", what);
+      failures++;
+   }
+}
+
+static void check_near (double value, double expected, double tolerance,
+                        const char *what)
+{
+   if (!(fabs (value - expected) <= tolerance))
+   {
+      printf ("FAIL: %s: %.6f, expected %.6f\n", what, value, expected);
+      failures++;
+   }
+}
+
+// Type K reference points from NIST ITS-90 tables (degC, mV)
+static const double tc_k_points[][2] = {
+   {-200, -5.891}, {-100, -3.554}, {0, 0.000}, {25, 1.000},
+   {100, 4.096}, {200, 8.138}, {300, 12.209}, {500, 20.644},
+   {800, 33.275}, {1000, 41.276}, {1300, 52.410}
+};
+
+static void check_tc_k (void)
+{
+   struct ljconv_data conv;
+   char what[64];
+   double value;
+   int i;
+
+   memset (&conv, 0, sizeof (conv));
+   conv.stage.kind = LJCONV_TC_K;
+   for (i = 0; i < (int) (sizeof (tc_k_points) / sizeof (tc_k_points[0]));
+        i++)
+   {
+      // Tables give 1 uV resolution, about 0.05 degC
+      value = tc_k_points[i][1] / 1000;
+      ljconv_apply (&conv, &value, 1);
+      snprintf (what, sizeof (what), "type K %.0f degC", tc_k_points[i][0]);
+      check_near (value, tc_k_points[i][0], 0.1, what);
+   }
+
+   // Thermocouple at 100 degC read with cold junction at 25 degC
+   conv.stage.coeffs[0] = 25;
+   value = (4.096 - 1.000) / 1000;
+   ljconv_apply (&conv, &value, 1);
+   check_near (value, 100, 0.1, "type K cold junction compensation");
+}
+
+static void check_rtd (void)
+{
+   struct ljconv_data conv;
+   double values[2] = { 100.0, 138.5055 };
+
+   memset (&conv, 0, sizeof (conv));
+   conv.stage.kind = LJCONV_RTD;
+   conv.stage.coeffs[0] = 100;
+   ljconv_apply (&conv, values, 2);
+   check_near (values[0], 0, 1e-6, "rtd at R0");
+   check_near (values[1], 100, 1e-3, "Pt100 at 138.5055 ohm");
+}
+
+static void check_table (void)
+{
+   static const double x[] = { -1, 0, 2, 6 };
+   static const double y[] = { 5, 10, 30, 10 };
+   struct ljconv_data conv;
+   double values[7] = { -5, -1, -0.5, 1, 2, 4, 9 };
+
+   memset (&conv, 0, sizeof (conv));
+   conv.stage.kind = LJCONV_TABLE;
+   conv.stage.npoints = 4;
+   memcpy (conv.stage.x, x, sizeof (x));
+   memcpy (conv.stage.y, y, sizeof (y));
+   ljconv_apply (&conv, values, 7);
+   check_near (values[0], 5, 1e-12, "table below first point");
+   check_near (values[1], 5, 1e-12, "table at first point");
+   check_near (values[2], 7.5, 1e-12, "table first segment");
+   check_near (values[3], 20, 1e-12, "table inner segment");
+   check_near (values[4], 30, 1e-12, "table at inner point");
+   check_near (values[5], 20, 1e-12, "table falling segment");
+   check_near (values[6], 10, 1e-12, "table above last point");
+}
+
+static void trigger_setup (struct ljtrig_data *trig, enum ljtrig_mode mode,
+                           double level, int pre, int post)
+{
+   free (trig->history);
+   free (trig->snapshot);
+   free (trig->output);
+   memset (trig, 0, sizeof (struct ljtrig_data));
+   ljmutex_init (&trig->lock);
+   trig->mode = mode;
+   trig->level = level;
+   trig->pre = pre;
+   trig->post = post;
+   trig->history = malloc ((pre + 1) * sizeof (double));
+   trig->snapshot = malloc ((pre + post) * sizeof (double));
+   trig->output = malloc ((pre + post) * sizeof (float));
+   emitted_count = 0;
+}
+
+// Snapshot emitted as expected values
+static void check_snapshot (const float *expected, int count,
+                            const char *what)
+{
+   int i;
+   int ok = emitted_count == count;
+   for (i = 0; ok && i < count; i++)
+      ok = emitted[i] == expected[i];
+   check (ok, what);
+}
+
+static void check_trigger (void)
+{
+   static struct ljtrig_data trig;
+   static const double ramp[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+   static const double low[] = { 1, 2, 3 };
+   static const double high[] = { 10, 11 };
+   static const float ramp_snapshot[] = { 3, 4, 5, 6, 7 };
+   static const float short_snapshot[] = { 1, 2, 3, 4 };
+   static const float edge_snapshot[] = { 2, 3, 10, 11 };
+   static const float below_snapshot[] = { 9, 10 };
+   static const float feedback_snapshot[] = { 12 };
+
+   // Pre trigger history and post samples in one block
+   trigger_setup (&trig, LJTRIG_RISING, 5.5, 3, 2);
+   ljtrig_push (&trig, NULL, ramp, 10);
+   check_snapshot (ramp_snapshot, 5, "trigger in one block");
+   check (trig.triggers == 1, "trigger count after one block");
+
+   // Same samples split so that history wraps and post spans blocks
+   trigger_setup (&trig, LJTRIG_RISING, 5.5, 3, 2);
+   ljtrig_push (&trig, NULL, ramp, 4);
+   ljtrig_push (&trig, NULL, ramp + 4, 2);
+   check (emitted_count == 0, "no snapshot before post samples");
+   ljtrig_push (&trig, NULL, ramp + 6, 4);
+   check_snapshot (ramp_snapshot, 5, "trigger across blocks");
+
+   // Fewer samples than pre trigger length before the trigger
+   trigger_setup (&trig, LJTRIG_ABOVE, 2.5, 5, 2);
+   ljtrig_push (&trig, NULL, ramp, 4);
+   check_snapshot (short_snapshot, 4, "short pre trigger history");
+
+   // Edge between the last sample of a block and the next block
+   trigger_setup (&trig, LJTRIG_RISING, 5, 2, 2);
+   ljtrig_push (&trig, NULL, low, 3);
+   ljtrig_push (&trig, NULL, high, 2);
+   check_snapshot (edge_snapshot, 4, "edge at block boundary");
+
+   // Without pre trigger history
+   trigger_setup (&trig, LJTRIG_BELOW, 9.5, 0, 2);
+   ljtrig_push (&trig, NULL, high, 2);
+   check (emitted_count == 0, "below level not reached");
+   ljtrig_push (&trig, NULL, ramp + 8, 2);
+   check_snapshot (below_snapshot, 2, "snapshot without pre history");
+
+   // Linked channel pushing back to the trigger while its snapshot is
+   // emitted triggers a nested snapshot
+   trigger_setup (&trig, LJTRIG_ABOVE, 9.5, 0, 1);
+   feedback_trigger = &trig;
+   feedback_value = 12;
+   ljtrig_push (&trig, NULL, ramp + 9, 1);
+   check_snapshot (feedback_snapshot, 1, "snapshot pushed back to trigger");
+   check (trig.triggers == 2, "trigger count with pushed back sample");
+   check (trig.output != NULL, "output buffer returned after emit");
+}
+
+// Read whole segment file. Returns NULL if the file can not be read.
+static char *spool_load (const char *basename, uint32_t index,
+                         uint64_t size)
+{
+   char filename[LJSPOOL_BASENAME_SIZE + 16];
+   char *data;
+   FILE *file;
+   ljspool_filename (filename, sizeof (filename), basename, index);
+   file = fopen (filename, "rb");
+   if (file == NULL)
+      return NULL;
+   data = malloc (size);
+   if (data != NULL && fread (data, 1, size, file) != size)
+   {
+      free (data);
+      data = NULL;
+   }
+   fclose (file);
+   return data;
+}
+
+static void check_spool (void)
+{
+   static struct ljspool_data spool;
+   struct ljspool_layout *layout = &spool.layout;
+   const struct ljspool_block *block;
+   double values[4];
+   uint32_t first;
+   uint32_t index;
+   int appended = 0;
+   int read = 0;
+   int ok = 1;
+   int i;
+
+   // Synchronous preparation without the preparer thread
+   memset (&spool, 0, sizeof (spool));
+   ljmutex_init (&spool.lock);
+   strcpy (layout->basename, "ljcheck_spool");
+   layout->segment_size = 4096;
+   layout->num_channels = 2;
+   strcpy (layout->names[0], "a");
+   strcpy (layout->names[1], "b");
+   first = ljspool_next_index (layout->basename);
+   spool.segment_index = first;
+   check (ljspool_create_next (&spool.current, layout,
+                               &spool.segment_index) == 0,
+          "spool first segment created");
+   ljspool_prepare (&spool);
+   check (spool.next.data != NULL, "spool next segment prepared");
+   if (spool.current.data == NULL || spool.next.data == NULL)
+      return;
+
+   // Blocks of 2 rows by 2 channels rotate to the next segment
+   for (i = 0; i < 100; i++)
+   {
+      values[0] = i;
+      values[1] = -i;
+      values[2] = i + 0.5;
+      values[3] = -i - 0.5;
+      if (ljspool_append (&spool, i, 0.5, 2, 2, values) == 0)
+         appended++;
+   }
+   check (appended == 100 && spool.blocks == 100, "spool blocks appended");
+   check (spool.current.index == first + 1, "spool rotated once");
+   check (spool.next.data != NULL, "spool next segment after rotation");
+
+   // Block larger than a segment is dropped and the segment kept
+   {
+      static double big[4096 / sizeof (double)];
+      check (ljspool_append (&spool, 0, 0, 256, 2, big) != 0
+             && spool.dropped == 1, "spool oversize block dropped");
+      check (spool.current.index == first + 1,
+             "spool segment kept after drop");
+   }
+
+   ljspool_segment_close (&spool.current);
+   ljspool_segment_close (&spool.retired);
+   ljspool_segment_discard (&spool.next, layout->basename);
+
+   // Walk blocks of both segments with the reader helpers
+   for (index = first; index <= first + 1; index++)
+   {
+      const struct ljspool_header *header;
+      char *data = spool_load (layout->basename, index, 4096);
+      char filename[LJSPOOL_BASENAME_SIZE + 16];
+      check (data != NULL, "spool segment readable");
+      if (data == NULL)
+         continue;
+      header = (const struct ljspool_header *) data;
+      check (memcmp (header->magic, LJSPOOL_MAGIC,
+                     sizeof (LJSPOOL_MAGIC)) == 0
+             && header->segment_index == index
+             && header->num_channels == 2
+             && strcmp (ljspool_channels (data)[1].name, "b") == 0,
+             "spool segment header");
+      for (block = ljspool_first_block (data); block != NULL;
+           block = ljspool_next_block (data, block))
+      {
+         const double *v = ljspool_block_values (block);
+         ok = ok && block->num_samples == 2 && block->num_channels == 2
+            && block->timestamp == read && block->interval == 0.5
+            && v[0] == read && v[1] == -read
+            && v[2] == read + 0.5 && v[3] == -read - 0.5;
+         read++;
+      }
+      free (data);
+      ljspool_filename (filename, sizeof (filename),
+                        layout->basename, index);
+      remove (filename);
+   }
+   check (ok && read == 100, "spool blocks read back in order");
+}
+
+int main (int argc, char *argv[])
+{
+   check_tc_k ();
+   check_rtd ();
+   check_table ();
+   check_trigger ();
+   check_spool ();
+   if (failures > 0)
+   {
+      printf ("%d checks failed\n", failures);
+      return 1;
+   }
+   printf ("All checks passed\n");
+   return 0;
+}
@@ -0,0 +1,419 @@
+/*
+RMCIOS - Reactive Multipurpose Control Input Output System
+Copyright (c) 2018 Frans Korhonen
+
+RMIOS was originally developed at Institute for Atmospheric
+and Earth System Research / Physics, Faculty of Science,
+University of Helsinki, Finland
+
+Assistance, experience and feedback from following persons have been
+critical for development of RMCIOS: Erkki Siivola, Juha Kangasluoma,
+Lauri Ahonen, Ella Häkkinen, Pasi Aalto, Joonas Enroth, Runlong Cai,
+Markku Kulmala and Tuukka Petäjä.
+
+This file is extension to RMCIOS. This notice was encoded using utf-8.
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+/**
+ * Engineering unit conversion stages for labjack channels.
+ * Conversions are evaluated in double precision over whole blocks of
+ * samples, so acquisition channels can convert without passing every
+ * sample through chained channels.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "ljconv.h"
+
+static struct ljconv_data *first_conversion = NULL;
+
+// NIST ITS-90 type K inverse coefficients (mV -> degC)
+static const double tc_k_inv_neg[] = {   // -5.891 mV .. 0 mV
+   0.0, 2.5173462e1, -1.1662878, -1.0833638, -8.9773540e-1,
+   -3.7342377e-1, -8.6632643e-2, -1.0450598e-2, -5.1920577e-4
+};
+static const double tc_k_inv_mid[] = {   // 0 mV .. 20.644 mV
+   0.0, 2.508355e1, 7.860106e-2, -2.503131e-1, 8.315270e-2,
+   -1.228034e-2, 9.804036e-4, -4.413030e-5, 1.057734e-6, -1.052755e-8
+};
+static const double tc_k_inv_high[] = {  // 20.644 mV .. 54.886 mV
+   -1.318058e2, 4.830222e1, -1.646031, 5.464731e-2,
+   -9.650715e-4, 8.802193e-6, -3.110810e-8
+};
+
+// NIST ITS-90 type K reference coefficients (degC -> mV)
+static const double tc_k_ref_neg[] = {   // -270 degC .. 0 degC
+   0.0, 3.9450128025e-2, 2.3622373598e-5, -3.2858906784e-7,
+   -4.9904828777e-9, -6.7509059173e-11, -5.7410327428e-13,
+   -3.1088872894e-15, -1.0451609365e-17, -1.9889266878e-20,
+   -1.6322697486e-23
+};
+static const double tc_k_ref_pos[] = {   // 0 degC .. 1372 degC
+   -1.7600413686e-2, 3.8921204975e-2, 1.8558770032e-5,
+   -9.9457592874e-8, 3.1840945719e-10, -5.6072844889e-13,
+   5.6075059059e-16, -3.2020720003e-19, 9.7151147152e-23,
+   -1.2104721275e-26
+};
+
+#define COUNT_OF(array) ((int) (sizeof (array) / sizeof (array[0])))
+
+static double polynomial (const double *c, int n, double x)
+{
+   double y = 0;
+   while (n-- > 0)
+      y = y * x + c[n];
+   return y;
+}
+
+static double tc_k_reference_mv (double t)
+{
+   if (t < 0)
+      return polynomial (tc_k_ref_neg, COUNT_OF (tc_k_ref_neg), t);
+   return polynomial (tc_k_ref_pos, COUNT_OF (tc_k_ref_pos), t)
+      + 0.1185976 * exp (-1.183432e-4 * (t - 126.9686) * (t - 126.9686));
+}
+
+static double tc_k_temperature (double mv)
+{
+   if (mv < 0)
+      return polynomial (tc_k_inv_neg, COUNT_OF (tc_k_inv_neg), mv);
+   if (mv < 20.644)
+      return polynomial (tc_k_inv_mid, COUNT_OF (tc_k_inv_mid), mv);
+   return polynomial (tc_k_inv_high, COUNT_OF (tc_k_inv_high), mv);
+}
+
+static double table_interpolate (const struct ljconv_stage *conv, double x)
+{
+   int low = 0;
+   int high = conv->npoints - 1;
+
+   if (conv->npoints < 1)
+      return x;
+   if (x <= conv->x[low])
+      return conv->y[low];
+   if (x >= conv->x[high])
+      return conv->y[high];
+
+   // Binary search for the segment containing x
+   while (high - low > 1)
+   {
+      int mid = (low + high) / 2;
+      if (conv->x[mid] <= x)
+         low = mid;
+      else
+         high = mid;
+   }
+   return conv->y[low] + (conv->y[high] - conv->y[low])
+      * (x - conv->x[low]) / (conv->x[high] - conv->x[low]);
+}
+
+// Copy settings published by setup. Table points beyond npoints are
+// not copied.
+static void ljconv_load (const struct ljconv_data *data,
+                         struct ljconv_stage *conv)
+{
+   unsigned seq;
+   do
+   {
+      seq = ljseq_read_begin (&data->seq);
+      conv->kind = data->stage.kind;
+      conv->ncoeffs = data->stage.ncoeffs;
+      if (conv->ncoeffs < 0 || conv->ncoeffs > LJCONV_MAX_COEFFS)
+         conv->ncoeffs = 0;     // Torn read, retried
+      memcpy (conv->coeffs, data->stage.coeffs, sizeof (conv->coeffs));
+      conv->npoints = data->stage.npoints;
+      if (conv->npoints < 0 || conv->npoints > LJCONV_MAX_POINTS)
+         conv->npoints = 0;     // Torn read, retried
+      memcpy (conv->x, data->stage.x, conv->npoints * sizeof (double));
+      memcpy (conv->y, data->stage.y, conv->npoints * sizeof (double));
+   }
+   while (ljseq_read_retry (&data->seq, seq));
+}
+
+void ljconv_apply (const struct ljconv_data *data, double *values, int count)
+{
+   struct ljconv_stage stage;
+   const struct ljconv_stage *conv = &stage;
+   int i;
+   if (data == NULL || count < 1)
+      return;
+   ljconv_load (data, &stage);
+
+   switch (conv->kind)
+   {
+   case LJCONV_NONE:
+      break;
+
+   case LJCONV_LINEAR:
+      {
+         double gain = conv->coeffs[0];
+         double offset = conv->coeffs[1];
+         for (i = 0; i < count; i++)
+            values[i] = gain * values[i] + offset;
+      }
+      break;
+
+   case LJCONV_POLY:
+      for (i = 0; i < count; i++)
+         values[i] = polynomial (conv->coeffs, conv->ncoeffs, values[i]);
+      break;
+
+   case LJCONV_TABLE:
+      for (i = 0; i < count; i++)
+         values[i] = table_interpolate (conv, values[i]);
+      break;
+
+   case LJCONV_TC_K:
+      {
+         // Cold junction compensation voltage is computed once per block
+         double cj_mv = tc_k_reference_mv (conv->coeffs[0]);
+         for (i = 0; i < count; i++)
+            values[i] = tc_k_temperature (values[i] * 1000.0 + cj_mv);
+      }
+      break;
+
+   case LJCONV_RTD:
+      {
+         // Callendar-Van Dusen with IEC 60751 coefficients.
+         // The quadratic form is used also below 0 degC.
+         const double A = 3.9083e-3;
+         const double B = -5.775e-7;
+         double r0 = conv->coeffs[0];
+         double current = conv->coeffs[1];
+         for (i = 0; i < count; i++)
+         {
+            double r = values[i];
+            if (current != 0)
+               r = r / current;
+            values[i] = (-A + sqrt (A * A - 4 * B * (1 - r / r0))) / (2 * B);
+         }
+      }
+      break;
+   }
+}
+
+// Parse parameter as double without narrowing through float
+static double ljconv_param_double (const struct context_rmcios *context,
+                                   enum type_rmcios paramtype,
+                                   const union param_rmcios param, int index)
+{
+   char buffer[40];
+   const char *str;
+   str = param_to_string (context, paramtype, param, index,
+                          sizeof (buffer), buffer);
+   return strtod (str, NULL);
+}
+
+struct ljconv_data *ljconv_find (int channel_id)
+{
+   struct ljconv_data *pconv = first_conversion;
+   while (pconv != NULL)
+   {
+      if (pconv->channel_id == channel_id)
+         return pconv;
+      pconv = pconv->next_conversion;
+   }
+   return NULL;
+}
+
+// Channel for configuring conversion stages
+void ljconv_func (struct ljconv_data *this,
+                  const struct context_rmcios *context, int id,
+                  enum function_rmcios function,
+                  enum type_rmcios paramtype,
+                  struct combo_rmcios *returnv,
+                  int num_params, const union param_rmcios param)
+{
+   switch (function)
+   {
+   case help_rmcios:
+      return_string (context, returnv,
+                     "labjack conversion channel"
+                     " - engineering unit conversion stage\r\n"
+                     " create ljmconv/ljconv newname\r\n"
+                     " setup newname linear gain | offset\r\n"
+                     " setup newname poly c0 | c1 | c2 ...\r\n"
+                     " setup newname table x0 y0 | x1 y1 ...\r\n"
+                     "   #points in ascending x order\r\n"
+                     " setup newname tc_k | cold_junction_degC(0)\r\n"
+                     "   #type K thermocouple volts -> degC\r\n"
+                     " setup newname rtd | R0(100) | excitation_current(0)\r\n"
+                     "   #platinum rtd ohms -> degC. With nonzero current\r\n"
+                     "   #input is voltage over the rtd.\r\n"
+                     " write newname value1 | value2 ...\r\n"
+                     "   #Convert and send results to linked\r\n"
+                     " read newname #Read latest converted value\r\n"
+                     " link newname channel\r\n"
+                     " Conversion is attached to acquisition channel with:\r\n"
+                     " setup acquisition_channel conversion newname\r\n");
+      break;
+
+   case create_rmcios:
+      if (num_params < 1)
+         break;
+      // Allocate new data:
+      this = (struct ljconv_data *) malloc (sizeof (struct ljconv_data));
+      if (this == NULL)
+         break;
+
+      // Set default values:
+      memset (this, 0, sizeof (struct ljconv_data));
+      this->stage.kind = LJCONV_NONE;
+      this->seq = 0;
+      ljmutex_init (&this->lock);
+      this->next_conversion = NULL;
+
+      // Create the channel
+      this->channel_id =
+         create_channel_param (context, paramtype, param, 0,
+                               (class_rmcios) ljconv_func, this);
+
+      // Add conversion to list of conversions:
+      this->next_conversion = first_conversion;
+      first_conversion = this;
+      break;
+
+   case setup_rmcios:
+      if (this == NULL)
+         break;
+      if (num_params < 1)
+         break;
+      {
+         struct ljconv_stage stage;
+         char buffer[20];
+         const char *kind;
+         int valid = 1;
+         int i;
+         kind = param_to_string (context, paramtype, param, 0,
+                                 sizeof (buffer), buffer);
+
+         // New settings are built aside and published at once
+         ljmutex_lock (&this->lock);
+         stage = this->stage;
+
+         if (strcmp (kind, "linear") == 0)
+         {
+            stage.coeffs[0] = 1;
+            stage.coeffs[1] = 0;
+            if (num_params > 1)
+               stage.coeffs[0] = ljconv_param_double (context, paramtype, param, 1);
+            if (num_params > 2)
+               stage.coeffs[1] = ljconv_param_double (context, paramtype, param, 2);
+            stage.ncoeffs = 2;
+            stage.kind = LJCONV_LINEAR;
+         }
+         else if (strcmp (kind, "poly") == 0)
+         {
+            stage.ncoeffs = num_params - 1;
+            if (stage.ncoeffs > LJCONV_MAX_COEFFS)
+            {
+               printf ("conversion: Too many coefficients\r\n");
+               stage.ncoeffs = LJCONV_MAX_COEFFS;
+            }
+            for (i = 0; i < stage.ncoeffs; i++)
+               stage.coeffs[i] =
+                  ljconv_param_double (context, paramtype, param, i + 1);
+            stage.kind = LJCONV_POLY;
+         }
+         else if (strcmp (kind, "table") == 0)
+         {
+            stage.npoints = (num_params - 1) / 2;
+            if (stage.npoints > LJCONV_MAX_POINTS)
+            {
+               printf ("conversion: Too many table points\r\n");
+               stage.npoints = LJCONV_MAX_POINTS;
+            }
+            for (i = 0; i < stage.npoints; i++)
+            {
+               stage.x[i] =
+                  ljconv_param_double (context, paramtype, param, 1 + i * 2);
+               stage.y[i] =
+                  ljconv_param_double (context, paramtype, param, 2 + i * 2);
+               if (i > 0 && stage.x[i] <= stage.x[i - 1])
+               {
+                  printf ("conversion: Table x values not ascending\r\n");
+                  stage.npoints = i;
+                  break;
+               }
+            }
+            stage.kind = LJCONV_TABLE;
+         }
+         else if (strcmp (kind, "tc_k") == 0)
+         {
+            stage.coeffs[0] = 0;
+            if (num_params > 1)
+               stage.coeffs[0] = ljconv_param_double (context, paramtype, param, 1);
+            stage.kind = LJCONV_TC_K;
+         }
+         else if (strcmp (kind, "rtd") == 0)
+         {
+            double r0 = 100;
+            double current = 0;
+            if (num_params > 1)
+               r0 = ljconv_param_double (context, paramtype, param, 1);
+            if (num_params > 2)
+               current = ljconv_param_double (context, paramtype, param, 2);
+            if (r0 > 0)
+            {
+               stage.coeffs[0] = r0;
+               stage.coeffs[1] = current;
+               stage.kind = LJCONV_RTD;
+            }
+            else
+            {
+               printf ("conversion: rtd R0 must be positive\r\n");
+               valid = 0;
+            }
+         }
+         else
+         {
+            printf ("conversion: Unknown conversion %s\r\n", kind);
+            valid = 0;
+         }
+         if (valid)
+         {
+            ljseq_write_begin (&this->seq);
+            this->stage = stage;
+            ljseq_write_end (&this->seq);
+         }
+         ljmutex_unlock (&this->lock);
+      }
+      break;
+
+   case write_rmcios:
+      if (this == NULL)
+         break;
+      if (num_params < 1)
+         break;
+      {
+         double values[num_params];
+         float results[num_params];
+         int i;
+         for (i = 0; i < num_params; i++)
+            values[i] = ljconv_param_double (context, paramtype, param, i);
+
+         ljconv_apply (this, values, num_params);
+
+         for (i = 0; i < num_params; i++)
+            results[i] = (float) values[i];
+         this->value = values[num_params - 1];
+         write_fv (context, linked_channels (context, id), num_params,
+                   results);
+         return_float (context, returnv, (float) this->value);
+      }
+      break;
+
+   case read_rmcios:
+      if (this == NULL)
+         break;
+      return_float (context, returnv, (float) this->value);
+      break;
+   }
+}
+
@@ -0,0 +1,62 @@
+/*
+ Engineering unit conversion stages shared by the labjack channel modules.
+*/
+
+#ifndef ljconv_h
+#define ljconv_h
+
+#include "RMCIOS-functions.h"
+#include "ljthread.h"
+
+#define LJCONV_MAX_COEFFS 16
+#define LJCONV_MAX_POINTS 64
+
+enum ljconv_kind
+{
+   LJCONV_NONE = 0,
+   LJCONV_LINEAR,       // y = gain * x + offset
+   LJCONV_POLY,         // y = c0 + c1*x + c2*x^2 ...
+   LJCONV_TABLE,        // piecewise linear interpolation of x,y points
+   LJCONV_TC_K,         // Type K thermocouple volts -> degC
+   LJCONV_RTD           // Pt RTD ohms (or volts/current) -> degC
+};
+
+// Conversion settings
+struct ljconv_stage
+{
+   enum ljconv_kind kind;
+   int ncoeffs;
+   double coeffs[LJCONV_MAX_COEFFS];
+   int npoints;
+   double x[LJCONV_MAX_POINTS];
+   double y[LJCONV_MAX_POINTS];
+};
+
+struct ljconv_data
+{
+   int channel_id;
+   ljmutex_t lock;      // Serializes setups
+   ljseq_t seq;         // Publishes stage to converting threads
+   struct ljconv_stage stage;
+   double value;        // Latest converted value
+   struct ljconv_data *next_conversion;
+};
+
+// Convert block of values in place. NULL conversion leaves values as is.
+// Settings are copied once per call, so setup may run concurrently with
+// acquisition threads and whole blocks should be passed.
+void ljconv_apply (const struct ljconv_data *conv, double *values, int count);
+
+// Find conversion channel by its channel id. Returns NULL if not found.
+struct ljconv_data *ljconv_find (int channel_id);
+
+// Channel for configuring conversion stages
+void ljconv_func (struct ljconv_data *this,
+                  const struct context_rmcios *context, int id,
+                  enum function_rmcios function,
+                  enum type_rmcios paramtype,
+                  struct combo_rmcios *returnv,
+                  int num_params, const union param_rmcios param);
+
+#endif
+
@@ -1,6 +1,6 @@
 include RMCIOS-build-scripts/utilities.mk
 
-SOURCES:=ljm_channels.c
+SOURCES:=ljm_channels.c ljconv.c ljspool.c ljtrig.c ljadapt.c ljm_trace.c ljtrace.c
 FILENAME:=ljm-module
 GCC?=${TOOL_PREFIX}gcc
 DLLTOOL?=${TOOL_PREFIX}dlltool
@@ -25,20 +25,81 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 // For printf
 #include <stdio.h>
+#include <stdint.h>
 
-// For the LabJackM Library
-#include <LabJackM.h>
+// For strtoul
+#include <stdlib.h>
+
+// For the LabJackM Library through traced wrappers
+#include "ljm_trace.h"
+#include "ljtrace.h"
 
 // Channel sytem utility functions
 #include "RMCIOS-functions.h"
 
+// Engineering unit conversions
+#include "ljconv.h"
+
+// Acquisition block spool
+#include "ljspool.h"
+
+// Triggered capture
+#include "ljtrig.h"
+
+// Adaptive polling
+#include "ljadapt.h"
+#include "ljtime.h"
+
+// Concurrent scans and device locks
+#include "ljthread.h"
+
+// Protects device and register lists
+static ljmutex_t ljm_lock;
+
 struct ljm_device_data
 {
    int channel_id;
    int handle;
+   ljmutex_t lock;      // Serializes driver calls to the device
    struct ljm_device_data *next_device;
 } *first_device = NULL;
 
+// Largest byte array transferred by register channels
+#define LJM_REGISTER_MAX_BYTES 4096
+
+// Register types passed as integers from driver to linked channels
+static int ljm_type_integer (int type)
+{
+   return type == LJM_UINT16 || type == LJM_UINT32 || type == LJM_INT32;
+}
+
+// Integer register value as channel int. UINT32 keeps its bit pattern.
+static int ljm_value_int (int type, double value)
+{
+   if (type == LJM_UINT32)
+      return (int) (uint32_t) value;
+   return (int) value;
+}
+
+// Parameter as value for register of given type
+static double ljm_param_value (const struct context_rmcios *context,
+                               enum type_rmcios paramtype,
+                               const union param_rmcios param,
+                               int index, int type)
+{
+   if (type == LJM_UINT32)
+   {
+      // Full unsigned range does not fit channel int
+      char text[32];
+      param_to_string (context, paramtype, param, index,
+                       sizeof (text), text);
+      return (uint32_t) strtoul (text, NULL, 0);
+   }
+   if (ljm_type_integer (type))
+      return param_to_int (context, paramtype, param, index);
+   return param_to_float (context, paramtype, param, index);
+}
+
 // Channel for handling labjack ljm devices
 void ljm_device_func (struct ljm_device_data *this,
                       const struct context_rmcios *context, int id,
@@ -58,7 +119,9 @@ void ljm_device_func (struct ljm_device_data *this,
                      "   for options on opening decice\r\n"
                      "write newname register value "
                      "  # Write value to register(name or id)\r\n"
-                     "read newname register #read register(name or id) value\r\n"                    
+                     "read newname register #read register(name or id) value\r\n"
+                     "  #UINT32 values above 2147483647 are read as\r\n"
+                     "  #negative int of same bits\r\n"
                      );
       break;
 
@@ -73,6 +136,8 @@ void ljm_device_func (struct ljm_device_data *this,
 
       // Set default values:
       this->handle = 0;
+      this->next_device = NULL;
+      ljmutex_init (&this->lock);
 
       // Create the channel
       this->channel_id =
@@ -80,6 +145,7 @@ void ljm_device_func (struct ljm_device_data *this,
                                (class_rmcios) ljm_device_func, this);
 
       //add device to list of devices:
+      ljmutex_lock (&ljm_lock);
       if (first_device == NULL)
       {
          // this is the first device in the system
@@ -94,6 +160,7 @@ void ljm_device_func (struct ljm_device_data *this,
          devices->next_device = this;   
          // Add this device to the list
       }
+      ljmutex_unlock (&ljm_lock);
       break;
 
    case setup_rmcios:
@@ -103,7 +170,10 @@ void ljm_device_func (struct ljm_device_data *this,
       // Open device for first found labjack on any connection.
       {
          int err;
-         err = LJM_OpenS ("LJM_dtANY", "LJM_ctANY", "LJM_idANY", &this->handle);
+         ljmutex_lock (&this->lock);
+         err = LJMT_OpenS ("LJM_dtANY", "LJM_ctANY", "LJM_idANY",
+                           &this->handle);
+         ljmutex_unlock (&this->lock);
       }
       else      
       // Open device with user parameters
@@ -118,8 +188,10 @@ void ljm_device_func (struct ljm_device_data *this,
                           sizeof (ConnectionType), ConnectionType);
          param_to_string (context, paramtype, param, 2,
                           sizeof (Identifier), Identifier);
+         ljmutex_lock (&this->lock);
          err =
-            LJM_OpenS (DeviceType, ConnectionType, Identifier, &this->handle);
+            LJMT_OpenS (DeviceType, ConnectionType, Identifier, &this->handle);
+         ljmutex_unlock (&this->lock);
       }
       break;
 
@@ -134,22 +206,22 @@ void ljm_device_func (struct ljm_device_data *this,
 
          int address;           // Modbus address of register
          int type;              // Type of register
-         int slen = param_string_alloc_size (context, paramtype, param, 0);
          // Check if register number given:
          address = param_to_integer (context, paramtype, param, 0);
          if (address == 0)      // not number -> Try as string
          {
-            char sbuff[slen];
+            char sbuff[LJM_MAX_NAME_SIZE];
             const char *name;
-            name = param_to_string (context, paramtype, param, 0, slen, sbuff);
+            name = param_to_string (context, paramtype, param, 0,
+                                    sizeof (sbuff), sbuff);
 
             // Try to get address and type of named register
-            LJM_NameToAddress (name, &address, &type);
+            LJMT_NameToAddress (name, &address, &type);
          }
          else
          {
             // Get the type of register by its address 
-            LJM_AddressToType (address, &type);
+            LJMT_AddressToType (address, &type);
 
          }
 
@@ -160,14 +232,21 @@ void ljm_device_func (struct ljm_device_data *this,
             if (type == LJM_STRING)     // Read string register
             {
                char str[LJM_STRING_ALLOCATION_SIZE];
-               LJM_eReadAddressString (this->handle, address, str);
+               ljmutex_lock (&this->lock);
+               LJMT_eReadAddressString (this->handle, address, str);
+               ljmutex_unlock (&this->lock);
                return_string (context, returnv, str);
             }
             else        // Read Numeric register
             {
                double value;
-               LJM_eReadAddress (this->handle, address, type, &value);
-               return_float (context, returnv, (float) value);
+               ljmutex_lock (&this->lock);
+               LJMT_eReadAddress (this->handle, address, type, &value);
+               ljmutex_unlock (&this->lock);
+               if (ljm_type_integer (type))
+                  return_int (context, returnv, ljm_value_int (type, value));
+               else
+                  return_float (context, returnv, (float) value);
             }
          }
          else   // write
@@ -180,14 +259,18 @@ void ljm_device_func (struct ljm_device_data *this,
                char str[LJM_STRING_ALLOCATION_SIZE];
                param_to_string (context, paramtype, param, 1,
                                 sizeof (str), str);
-               LJM_eWriteAddressString (this->handle, address, str);
+               ljmutex_lock (&this->lock);
+               LJMT_eWriteAddressString (this->handle, address, str);
+               ljmutex_unlock (&this->lock);
             }
             else       
             // write numeric register
             {
-               float value;
-               value = param_to_float (context, paramtype, param, 1);
-               LJM_eWriteAddress (this->handle, address, type, (float) value);
+               double value;
+               value = ljm_param_value (context, paramtype, param, 1, type);
+               ljmutex_lock (&this->lock);
+               LJMT_eWriteAddress (this->handle, address, type, value);
+               ljmutex_unlock (&this->lock);
             }
          }
       }
@@ -197,13 +280,113 @@ void ljm_device_func (struct ljm_device_data *this,
 
 struct ljm_register_data
 {
+   int channel_id;
    struct ljm_device_data *device;
    int address;
    int type;
 
    int len_address;
    int len_type;
-};
+
+   struct ljconv_data *conversion;
+   struct ljtrig_data *trigger;
+   struct ljadapt_data adapt;
+   ljseq_t seq;         // Publishes value and adapt to readers
+   double value;        // Latest numeric value after conversion
+   int has_value;       // Value has been read at least once
+   struct ljm_register_data *next_register;
+} *first_register = NULL;
+
+// Publish new value. Called with device lock held.
+static void ljm_register_publish (struct ljm_register_data *this,
+                                  double value)
+{
+   ljseq_write_begin (&this->seq);
+   this->value = value;
+   this->has_value = 1;
+   ljseq_write_end (&this->seq);
+}
+
+// Latest published value. Returns zero when nothing is published yet.
+static int ljm_register_value (struct ljm_register_data *this,
+                               double *value)
+{
+   int has_value;
+   unsigned seq;
+   do
+   {
+      seq = ljseq_read_begin (&this->seq);
+      *value = this->value;
+      has_value = this->has_value;
+   }
+   while (ljseq_read_retry (&this->seq, seq));
+   return has_value;
+}
+
+// Read numeric register or reuse latest value when adaptive polling
+// does not require bus access yet. Returns 1 for a fresh value, 0 when
+// the latest value is reused and negative LJM error code when the read
+// failed. Nothing is published on error. Called with device lock held.
+static int ljm_register_poll (struct ljm_register_data *this)
+{
+   double start = ljtime_monotonic ();
+   double value;
+   int err;
+   if (!ljadapt_due (&this->adapt, start))
+   {
+      ljseq_write_begin (&this->seq);
+      ljadapt_skip (&this->adapt);
+      ljseq_write_end (&this->seq);
+      return 0;
+   }
+   err = LJMT_eReadAddress (this->device->handle, this->address,
+                            this->type, &value);
+   if (err != 0)
+   {
+      printf ("ljmreg: Read error %d\r\n", err);
+      return -err;
+   }
+   ljseq_write_begin (&this->seq);
+   ljadapt_update (&this->adapt, value, start, ljtime_monotonic () - start);
+   ljseq_write_end (&this->seq);
+   ljconv_apply (this->conversion, &value, 1);
+   ljm_register_publish (this, value);
+   return 1;
+}
+
+// Integer register without conversion keeps integer values
+static int ljm_register_integer (struct ljm_register_data *this)
+{
+   return this->conversion == NULL && ljm_type_integer (this->type);
+}
+
+// Read byte array of length in length register to buffer of
+// LJM_REGISTER_MAX_BYTES. Returns number of bytes read.
+static int ljm_register_read_bytes (struct ljm_register_data *this,
+                                    char *buffer)
+{
+   double len = 0;
+   int blen;
+   int errorAddress;
+   ljmutex_lock (&this->device->lock);
+   LJMT_eReadAddress (this->device->handle,
+                      this->len_address, this->len_type, &len);
+   blen = len;
+   if (blen < 0)
+      blen = 0;
+   if (blen > LJM_REGISTER_MAX_BYTES)
+   {
+      printf ("ljmreg: Byte array of %d bytes truncated\r\n", blen);
+      blen = LJM_REGISTER_MAX_BYTES;
+   }
+   LJMT_eReadAddressByteArray (this->device->handle, //int Handle,
+                               this->address,        //int Address,
+                               blen,                 //int NumBytes,
+                               buffer,               //char * aBytes,
+                               &errorAddress);       //int * ErrorAddress
+   ljmutex_unlock (&this->device->lock);
+   return blen;
+}
 
 // Cannel for handling registers in a ljm device. 
 void ljm_register_func (struct ljm_register_data *this,
@@ -229,6 +412,23 @@ void ljm_register_func (struct ljm_register_data *this,
                      " write newname \r\n"
                      "       #read register and send results to linked\r\n"
                      " read newname value #Read register\r\n"
+                     "       #UINT16, UINT32 and INT32 registers without\r\n"
+                     "       #conversion are read and written as integers\r\n"
+                     "       #UINT32 values above 2147483647 are read as\r\n"
+                     "       #negative int of same bits. Writes accept\r\n"
+                     "       #the full unsigned range.\r\n"
+                     " setup newname conversion conversion_channel\r\n"
+                     "       #Convert numeric values with ljmconv channel\r\n"
+                     " setup newname trigger trigger_channel\r\n"
+                     "       #Feed polled values to ljmtrig channel\r\n"
+                     " setup newname adaptive min_interval max_interval\r\n"
+                     "       | deadband(0)\r\n"
+                     "       #Poll at min_interval seconds while value\r\n"
+                     "       #changes more than deadband and back off\r\n"
+                     "       #to max_interval while stable.\r\n"
+                     "       #Skipped polls reuse latest value.\r\n"
+                     " read newname saved\r\n"
+                     "       #Read bus seconds saved by adaptive polling\r\n"
                      " link newname channel\r\n");
       break;
 
@@ -248,21 +448,67 @@ void ljm_register_func (struct ljm_register_data *this,
       this->device = NULL;
       this->len_address = 0;
       this->len_type = 0;
+      this->conversion = NULL;
+      this->trigger = NULL;
+      this->seq = 0;
+      this->value = 0;
+      this->has_value = 0;
+      ljadapt_init (&this->adapt);
 
       // Create the channel
-      create_channel_param (context, paramtype, param, 0,
-                            (class_rmcios) ljm_register_func, this);
+      this->channel_id =
+         create_channel_param (context, paramtype, param, 0,
+                               (class_rmcios) ljm_register_func, this);
+
+      // Add register to list of registers:
+      ljmutex_lock (&ljm_lock);
+      this->next_register = first_register;
+      first_register = this;
+      ljmutex_unlock (&ljm_lock);
       break;
    case setup_rmcios:
       if (this == NULL)
          break;
       if (num_params < 2)
          break;
+      char keyword[20];
+      param_to_string (context, paramtype, param, 0, sizeof (keyword), keyword);
+      if (strcmp (keyword, "conversion") == 0)
+      {
+         this->conversion =
+            ljconv_find (param_to_int (context, paramtype, param, 1));
+         if (this->conversion == NULL)
+            printf ("ljmreg: Could not find conversion channel\r\n");
+         break;
+      }
+      if (strcmp (keyword, "trigger") == 0)
+      {
+         this->trigger =
+            ljtrig_find (param_to_int (context, paramtype, param, 1));
+         if (this->trigger == NULL)
+            printf ("ljmreg: Could not find trigger channel\r\n");
+         break;
+      }
+      if (strcmp (keyword, "adaptive") == 0)
+      {
+         double deadband = 0;
+         if (num_params < 3)
+            break;
+         if (num_params > 3)
+            deadband = param_to_float (context, paramtype, param, 3);
+         ljadapt_setup (&this->adapt,
+                        param_to_float (context, paramtype, param, 1),
+                        param_to_float (context, paramtype, param, 2),
+                        deadband);
+         break;
+      }
+
       int device_channel = param_to_int (context, paramtype, param, 0);
       if (device_channel == 0)
          break;
 
       // Find the specified device:
+      ljmutex_lock (&ljm_lock);
       struct ljm_device_data *pdevice = first_device;
       while (pdevice != NULL)
       {
@@ -275,6 +521,7 @@ void ljm_register_func (struct ljm_register_data *this,
          }
          pdevice = pdevice->next_device;
       }
+      ljmutex_unlock (&ljm_lock);
       if (this->device == NULL)
       {
          printf ("ljmreg: Could not find LJM device channel\r\n");
@@ -282,7 +529,7 @@ void ljm_register_func (struct ljm_register_data *this,
       // Get register address for the channel
       int address; // Modbus address of register
       int type;    // Type of register
-      int slen = param_string_alloc_size (context, paramtype, param, 1);
+      char sbuff[LJM_MAX_NAME_SIZE];
       
       // Check if register as number given:
       address = param_to_integer (context, paramtype, param, 1);
@@ -290,17 +537,17 @@ void ljm_register_func (struct ljm_register_data *this,
       if (address == 0) 
       // not number -> Try as string
       {
-         char sbuff[slen];
          const char *name;
-         name = param_to_string (context, paramtype, param, 1, slen, sbuff);
+         name = param_to_string (context, paramtype, param, 1,
+                                 sizeof (sbuff), sbuff);
          
          // Get address and type of named register
-         LJM_NameToAddress (name, &address, &type);
+         LJMT_NameToAddress (name, &address, &type);
       }
       else
       {
          // Get the type of register by its address 
-         LJM_AddressToType (address, &type);
+         LJMT_AddressToType (address, &type);
       }
       this->address = address;
       this->type = type;
@@ -332,16 +579,16 @@ void ljm_register_func (struct ljm_register_data *this,
       address = param_to_integer (context, paramtype, param, 3);
       if (address == 0) // not number -> Try as string
       {
-         char sbuff[slen];
          const char *name;
-         name = param_to_string (context, paramtype, param, 3, slen, sbuff);
+         name = param_to_string (context, paramtype, param, 3,
+                                 sizeof (sbuff), sbuff);
          // Get address and type of named register
-         LJM_NameToAddress (name, &address, &type);
+         LJMT_NameToAddress (name, &address, &type);
       }
       else
       {
          // Get the type of register by its address 
-         LJM_AddressToType (address, &type);
+         LJMT_AddressToType (address, &type);
       }
       this->len_address = address;
       this->len_type = LJM_UINT32;
@@ -350,6 +597,25 @@ void ljm_register_func (struct ljm_register_data *this,
    case read_rmcios:
       if (this == NULL)
          break;
+      if (num_params > 0)
+      {
+         char keyword[20];
+         param_to_string (context, paramtype, param, 0,
+                          sizeof (keyword), keyword);
+         if (strcmp (keyword, "saved") == 0)
+         {
+            double saved;
+            unsigned seq;
+            do
+            {
+               seq = ljseq_read_begin (&this->seq);
+               saved = this->adapt.saved_time;
+            }
+            while (ljseq_read_retry (&this->seq, seq));
+            return_float (context, returnv, (float) saved);
+            break;
+         }
+      }
       if (this->device == NULL)
          break;
       if (this->type == LJM_STRING)     // Read string register
@@ -357,36 +623,41 @@ void ljm_register_func (struct ljm_register_data *this,
          if (this->len_address == 0)
          {
             char str[LJM_STRING_ALLOCATION_SIZE];
-            LJM_eReadAddressString (this->device->handle, this->address, str);
+            ljmutex_lock (&this->device->lock);
+            LJMT_eReadAddressString (this->device->handle, this->address, str);
+            ljmutex_unlock (&this->device->lock);
             return_string (context, returnv, str);
          }
          else   // read raw bytes
          {
-            double len;
-            int blen;
-            LJM_eReadAddress (this->device->handle,
-                              this->len_address, this->len_type, &len);
-            blen = len;
-            {
-               char buffer[blen];
-               int errorAddress;
-
-               LJM_eReadAddressByteArray (this->device->handle, //int Handle,
-                                          this->address,        //int Address,
-                                          blen, // int NumBytes,
-                                          buffer, // char * aBytes,
-                                          &errorAddress); //int * ErrorAddress) ;
-
-               return_buffer (context, returnv, buffer, blen);
-            }
+            char buffer[LJM_REGISTER_MAX_BYTES];
+            int blen = ljm_register_read_bytes (this, buffer);
+            return_buffer (context, returnv, buffer, blen);
          }
       }
       else      // Read Numeric register
       {
          double value;
-         LJM_eReadAddress (this->device->handle, this->address,
-                           this->type, &value);
-         return_float (context, returnv, (float) value);
+         // Readers do not wait for the bus. While another thread
+         // uses the device its latest value is returned. Until the
+         // first value exists the reader waits for the device.
+         if (ljmutex_trylock (&this->device->lock))
+         {
+            ljm_register_poll (this);
+            ljmutex_unlock (&this->device->lock);
+         }
+         if (!ljm_register_value (this, &value))
+         {
+            ljmutex_lock (&this->device->lock);
+            ljm_register_poll (this);
+            ljmutex_unlock (&this->device->lock);
+            if (!ljm_register_value (this, &value))
+               break;   // No value read yet
+         }
+         if (ljm_register_integer (this))
+            return_int (context, returnv, ljm_value_int (this->type, value));
+         else
+            return_float (context, returnv, (float) value);
       }
       break;
    case write_rmcios:
@@ -401,42 +672,45 @@ void ljm_register_func (struct ljm_register_data *this,
             if (this->len_address == 0)
             {
                char str[LJM_STRING_ALLOCATION_SIZE];
-               LJM_eReadAddressString (this->device->handle,
+               ljmutex_lock (&this->device->lock);
+               LJMT_eReadAddressString (this->device->handle,
                                        this->address, str);
+               ljmutex_unlock (&this->device->lock);
                write_str (context, linked_channels (context, id), str, 0);
                return_string (context, returnv, str);
             }
             else
             {
-               double len;
-               int blen;
-               LJM_eReadAddress (this->device->handle,
-                                 this->len_address, this->len_type, &len);
-               blen = len;
-               {
-                  char buffer[blen];
-                  int errorAddress;
-
-                  LJM_eReadAddressByteArray (this->device->handle, //int Handle,
-                                             this->address,     //int Address,
-                                             blen,      // int NamBytes,
-                                             buffer,    // char * aBytes,
-                                             //int * ErrorAddress :
-                                             &errorAddress);
-
-                  write_buffer (context,
-                                linked_channels (context, id), buffer, blen, 0);
-                  return_buffer (context, returnv, buffer, blen);
-               }
+               char buffer[LJM_REGISTER_MAX_BYTES];
+               int blen = ljm_register_read_bytes (this, buffer);
+               write_buffer (context,
+                             linked_channels (context, id), buffer, blen, 0);
+               return_buffer (context, returnv, buffer, blen);
             }
          }
          else   // Read Numeric register
          {
+            int fresh;
             double value;
-            LJM_eReadAddress (this->device->handle, this->address,
-                              this->type, &value);
-            write_f (context, linked_channels (context, id), (float) value);
-            return_float (context, returnv, (float) value);
+            ljmutex_lock (&this->device->lock);
+            fresh = ljm_register_poll (this);
+            value = this->value;
+            ljmutex_unlock (&this->device->lock);
+            if (fresh < 0)
+               break;
+            if (fresh)
+               ljtrig_push (this->trigger, context, &value, 1);
+            if (ljm_register_integer (this))
+            {
+               int ivalue = ljm_value_int (this->type, value);
+               write_i (context, linked_channels (context, id), ivalue);
+               return_int (context, returnv, ivalue);
+            }
+            else
+            {
+               write_f (context, linked_channels (context, id), (float) value);
+               return_float (context, returnv, (float) value);
+            }
          }
       }
       else      // Write to register
@@ -445,47 +719,486 @@ void ljm_register_func (struct ljm_register_data *this,
          {
             char str[LJM_STRING_ALLOCATION_SIZE];
             param_to_string (context, paramtype, param, 0, sizeof (str), str);
-            LJM_eWriteAddressString (this->device->handle, this->address, str);
+            ljmutex_lock (&this->device->lock);
+            LJMT_eWriteAddressString (this->device->handle, this->address, str);
+            ljmutex_unlock (&this->device->lock);
          }
          else if (this->type == LJM_BYTE)       // Byte array
          {
-            int plen;
-            int psize;
             int errorAddress;
-
-            psize = param_buffer_alloc_size (context, paramtype, param, 0);
-            plen = param_buffer_length (context, paramtype, param, 0);
             {
-               char buffer[psize];
+               char buffer[LJM_REGISTER_MAX_BYTES];
                struct buffer_rmcios pb;
                // get the paremeter 
                pb = param_to_buffer (context, paramtype, param, 0,
-                                     psize, buffer);
+                                     sizeof (buffer), buffer);
 
                // Write length to the length -register
+               ljmutex_lock (&this->device->lock);
                if (this->len_address != 0)
                {
-                  LJM_eWriteAddress (this->device->handle,
+                  LJMT_eWriteAddress (this->device->handle,
                                      this->len_address,
                                      this->len_type, pb.length);
                }
 
 
                // Write the data
-               LJM_eWriteAddressByteArray (this->device->handle, //int Handle,
+               LJMT_eWriteAddressByteArray (this->device->handle, //int Handle,
                                            this->address,       //int Address,
                                            pb.length,   //int NumBytes,
                                            pb.data,     //const char * aBytes,
                                            &errorAddress); //int * ErrorAddress
+               ljmutex_unlock (&this->device->lock);
             }
          }
          else   // write numeric register
          {
-            float value;
-            value = param_to_float (context, paramtype, param, 0);
-            LJM_eWriteAddress (this->device->handle, this->address,
+            double value;
+            value = ljm_param_value (context, paramtype, param, 0,
+                                     this->type);
+            ljmutex_lock (&this->device->lock);
+            LJMT_eWriteAddress (this->device->handle, this->address,
                                this->type, value);
+            ljmutex_unlock (&this->device->lock);
+         }
+      }
+      break;
+   }
+}
+
+#define LJM_SCAN_MAX_DEVICES 16
+#define LJM_SCAN_MAX_REGISTERS 128
+
+// Registers of one device in a scan
+struct ljm_scan_group
+{
+   struct ljm_device_data *device;
+   double offset;       // Device time offset in seconds
+   int count;
+   int addresses[LJM_SCAN_MAX_REGISTERS];
+   int types[LJM_SCAN_MAX_REGISTERS];
+   double values[LJM_SCAN_MAX_REGISTERS];
+   int frame_index[LJM_SCAN_MAX_REGISTERS];     // Position in frame
+   struct ljm_register_data *registers[LJM_SCAN_MAX_REGISTERS];
+   double timestamp;    // Corrected midpoint of latest read
+   int err;
+   int worker;          // Worker thread reads the group
+   ljthread_t thread;
+   ljsem_t start;       // Posted to start read in worker
+   ljsem_t done;        // Posted by worker when read is done
+};
+
+// Time offset configured for a device
+struct ljm_scan_offset
+{
+   struct ljm_device_data *device;
+   double offset;
+};
+
+struct ljm_scan_data
+{
+   ljmutex_t lock;      // Serializes scans and setup
+   int num_groups;
+   struct ljm_scan_group groups[LJM_SCAN_MAX_DEVICES];
+   int num_offsets;
+   struct ljm_scan_offset offsets[LJM_SCAN_MAX_DEVICES];
+   int num_registers;
+   struct ljm_register_data *registers[LJM_SCAN_MAX_REGISTERS];
+   double frame[LJM_SCAN_MAX_REGISTERS];
+   float output[LJM_SCAN_MAX_REGISTERS + 1];
+   double timestamp;    // Frame time
+   double epoch;        // Monotonic time of setup
+   double skew;         // Spread of device timestamps in latest frame
+   double duration;     // Duration of latest scan
+   int err;             // First device error of latest scan
+   int errors;          // Frames dropped due to read errors
+   struct ljspool_data *spool;
+};
+
+// Add register to group after registers of the same conversion, so
+// each conversion is applied to a block of values.
+static void ljm_scan_group_add (struct ljm_scan_group *group,
+                                struct ljm_register_data *reg,
+                                int frame_index)
+{
+   int i = group->count;
+   int j;
+   for (j = 0; j < group->count; j++)
+   {
+      if (group->registers[j]->conversion == reg->conversion)
+         i = j + 1;
+   }
+   for (j = group->count; j > i; j--)
+   {
+      group->addresses[j] = group->addresses[j - 1];
+      group->types[j] = group->types[j - 1];
+      group->frame_index[j] = group->frame_index[j - 1];
+      group->registers[j] = group->registers[j - 1];
+   }
+   group->addresses[i] = reg->address;
+   group->types[i] = reg->type;
+   group->frame_index[i] = frame_index;
+   group->registers[i] = reg;
+   group->count++;
+}
+
+// Read all registers of a device group with one call. Converted values
+// are published to the registers while the device is locked. Values
+// of a failed read are not published.
+static void ljm_scan_group_read (struct ljm_scan_group *group)
+{
+   int errorAddress;
+   int i;
+   int j;
+   double start;
+   ljmutex_lock (&group->device->lock);
+   start = ljtime_monotonic ();
+   group->err = LJMT_eReadAddresses (group->device->handle, group->count,
+                                     group->addresses, group->types,
+                                     group->values, &errorAddress);
+   group->timestamp =
+      (start + ljtime_monotonic ()) / 2 - group->offset;
+   for (i = 0; group->err == 0 && i < group->count; i = j)
+   {
+      // Registers of same conversion are adjacent, convert them at once
+      struct ljconv_data *conversion = group->registers[i]->conversion;
+      for (j = i + 1; j < group->count
+           && group->registers[j]->conversion == conversion; j++);
+      ljconv_apply (conversion, group->values + i, j - i);
+   }
+   for (i = 0; group->err == 0 && i < group->count; i++)
+      ljm_register_publish (group->registers[i], group->values[i]);
+   ljmutex_unlock (&group->device->lock);
+}
+
+// Worker reading its group each time a scan starts it
+static LJTHREAD_FUNC (ljm_scan_thread, arg)
+{
+   struct ljm_scan_group *group = (struct ljm_scan_group *) arg;
+   for (;;)
+   {
+      ljsem_wait (&group->start);
+      ljm_scan_group_read (group);
+      ljsem_post (&group->done);
+   }
+   LJTHREAD_RETURN;
+}
+
+// Start worker thread for group. Workers live as long as the scan
+// channel and are reused when groups are rebuilt.
+static void ljm_scan_worker (struct ljm_scan_group *group)
+{
+   if (group->worker)
+      return;
+   ljsem_init (&group->start);
+   ljsem_init (&group->done);
+   group->worker =
+      ljthread_start (&group->thread, ljm_scan_thread, group) == 0;
+   if (!group->worker)
+   {
+      ljsem_destroy (&group->start);
+      ljsem_destroy (&group->done);
+   }
+}
+
+// Read all devices concurrently and combine results to frame.
+// Called with scan lock held.
+static void ljm_scan (struct ljm_scan_data *this)
+{
+   double start = ljtime_monotonic ();
+   double tmin = 0;
+   double tmax = 0;
+   double tsum = 0;
+   int i;
+   int j;
+
+   // Start reads on all but the first device in workers
+   for (i = 1; i < this->num_groups; i++)
+   {
+      if (this->groups[i].worker)
+         ljsem_post (&this->groups[i].start);
+      else
+         ljm_scan_group_read (&this->groups[i]);
+   }
+   if (this->num_groups > 0)
+      ljm_scan_group_read (&this->groups[0]);
+   for (i = 1; i < this->num_groups; i++)
+   {
+      if (this->groups[i].worker)
+         ljsem_wait (&this->groups[i].done);
+   }
+   this->duration = ljtime_monotonic () - start;
+
+   // Combine to frame in configured register order
+   this->err = 0;
+   for (i = 0; i < this->num_groups; i++)
+   {
+      struct ljm_scan_group *group = &this->groups[i];
+      if (group->err != 0)
+      {
+         printf ("ljmscan: Read error %d\r\n", group->err);
+         if (this->err == 0)
+            this->err = group->err;
+      }
+      for (j = 0; j < group->count; j++)
+         this->frame[group->frame_index[j]] = group->values[j];
+      if (i == 0 || group->timestamp < tmin)
+         tmin = group->timestamp;
+      if (i == 0 || group->timestamp > tmax)
+         tmax = group->timestamp;
+      tsum += group->timestamp;
+   }
+   if (this->num_groups > 0)
+      this->timestamp = tsum / this->num_groups;
+   this->skew = tmax - tmin;
+}
+
+// Channel for synchronized scans over several ljm devices
+void ljm_scan_func (struct ljm_scan_data *this,
+                    const struct context_rmcios *context, int id,
+                    enum function_rmcios function,
+                    enum type_rmcios paramtype,
+                    struct combo_rmcios *returnv,
+                    int num_params, const union param_rmcios param)
+{
+   switch (function)
+   {
+   case help_rmcios:
+      return_string (context, returnv,
+                     "ljm scan channel"
+                     " - synchronized scan over several ljm devices\r\n"
+                     " create ljmscan newname\r\n"
+                     " setup newname ljmreg_channel1 | ljmreg_channel2 ...\r\n"
+                     "       #Numeric registers to scan. Registers of each\r\n"
+                     "       #device are read with one call and devices\r\n"
+                     "       #are read concurrently.\r\n"
+                     " setup newname offset ljm_device_channel seconds\r\n"
+                     "       #Time offset subtracted from device timestamps\r\n"
+                     "       #Kept when registers are set up again.\r\n"
+                     " setup newname spool spool_channel\r\n"
+                     "       #Append frames to ljmspool channel\r\n"
+                     " write newname\r\n"
+                     "       #Scan and send frame to linked channels:\r\n"
+                     "       #time_since_setup value1 value2 ...\r\n"
+                     "       #Frames with device read errors are dropped.\r\n"
+                     " read newname #Read duration of latest scan\r\n"
+                     " read newname skew\r\n"
+                     "       #Read spread of device timestamps\r\n"
+                     " read newname errors\r\n"
+                     "       #Read number of dropped frames\r\n"
+                     " link newname channel\r\n");
+      break;
+
+   case create_rmcios:
+      if (num_params < 1)
+         break;
+      // Allocate new data:
+      this = (struct ljm_scan_data *) malloc (sizeof (struct ljm_scan_data));
+      if (this == NULL)
+         break;
+
+      // Set default values:
+      memset (this, 0, sizeof (struct ljm_scan_data));
+      this->spool = NULL;
+      ljmutex_init (&this->lock);
+
+      // Create the channel
+      create_channel_param (context, paramtype, param, 0,
+                            (class_rmcios) ljm_scan_func, this);
+      break;
+
+   case setup_rmcios:
+      if (this == NULL)
+         break;
+      if (num_params < 1)
+         break;
+      {
+         char keyword[20];
+         int i;
+         int j;
+         param_to_string (context, paramtype, param, 0,
+                          sizeof (keyword), keyword);
+         if (strcmp (keyword, "spool") == 0)
+         {
+            struct ljspool_data *spool;
+            if (num_params < 2)
+               break;
+            spool = ljspool_find (param_to_int (context, paramtype, param, 1));
+            if (spool == NULL)
+               printf ("ljmscan: Could not find spool channel\r\n");
+            ljmutex_lock (&this->lock);
+            this->spool = spool;
+            ljmutex_unlock (&this->lock);
+            break;
+         }
+         if (strcmp (keyword, "offset") == 0)
+         {
+            int device_channel;
+            double offset;
+            struct ljm_device_data *device;
+            if (num_params < 3)
+               break;
+            device_channel = param_to_int (context, paramtype, param, 1);
+            offset = param_to_float (context, paramtype, param, 2);
+            ljmutex_lock (&ljm_lock);
+            device = first_device;
+            while (device != NULL && device->channel_id != device_channel)
+               device = device->next_device;
+            ljmutex_unlock (&ljm_lock);
+            if (device == NULL)
+            {
+               printf ("ljmscan: Could not find LJM device channel\r\n");
+               break;
+            }
+
+            // Offsets are kept per device for later register setups
+            ljmutex_lock (&this->lock);
+            for (i = 0; i < this->num_offsets; i++)
+            {
+               if (this->offsets[i].device == device)
+                  break;
+            }
+            if (i == this->num_offsets)
+            {
+               if (i >= LJM_SCAN_MAX_DEVICES)
+                  printf ("ljmscan: Too many devices\r\n");
+               else
+               {
+                  this->offsets[i].device = device;
+                  this->num_offsets++;
+               }
+            }
+            if (i < this->num_offsets)
+               this->offsets[i].offset = offset;
+            for (i = 0; i < this->num_groups; i++)
+            {
+               if (this->groups[i].device == device)
+                  this->groups[i].offset = offset;
+            }
+            ljmutex_unlock (&this->lock);
+            break;
+         }
+
+         // Collect registers and group them by device
+         ljmutex_lock (&this->lock);
+         this->epoch = ljtime_monotonic ();
+         this->num_groups = 0;
+         this->num_registers = 0;
+         for (i = 0; i < num_params; i++)
+         {
+            int channel = param_to_int (context, paramtype, param, i);
+            struct ljm_register_data *reg;
+            struct ljm_scan_group *group = NULL;
+
+            ljmutex_lock (&ljm_lock);
+            reg = first_register;
+            while (reg != NULL && reg->channel_id != channel)
+               reg = reg->next_register;
+            ljmutex_unlock (&ljm_lock);
+            if (reg == NULL || reg->device == NULL
+                || reg->type == LJM_STRING || reg->type == LJM_BYTE)
+            {
+               printf ("ljmscan: Parameter %d is not numeric ljmreg\r\n",
+                       i);
+               continue;
+            }
+            if (this->num_registers >= LJM_SCAN_MAX_REGISTERS)
+            {
+               printf ("ljmscan: Too many registers\r\n");
+               break;
+            }
+            for (j = 0; j < this->num_groups; j++)
+            {
+               if (this->groups[j].device == reg->device)
+                  group = &this->groups[j];
+            }
+            if (group == NULL)
+            {
+               if (this->num_groups >= LJM_SCAN_MAX_DEVICES)
+               {
+                  printf ("ljmscan: Too many devices\r\n");
+                  continue;
+               }
+               group = &this->groups[this->num_groups++];
+               group->device = reg->device;
+               group->offset = 0;
+               group->count = 0;
+               for (j = 0; j < this->num_offsets; j++)
+               {
+                  if (this->offsets[j].device == reg->device)
+                     group->offset = this->offsets[j].offset;
+               }
+               if (group != &this->groups[0])
+                  ljm_scan_worker (group);
+            }
+            ljm_scan_group_add (group, reg, this->num_registers);
+            this->registers[this->num_registers++] = reg;
          }
+         ljmutex_unlock (&this->lock);
+      }
+      break;
+
+   case write_rmcios:
+      if (this == NULL)
+         break;
+      if (this->num_registers < 1)
+         break;
+      {
+         int i;
+         ljmutex_lock (&this->lock);
+         ljm_scan (this);
+         if (this->err != 0)
+         {
+            // Incomplete frame is not spooled or sent
+            this->errors++;
+            ljmutex_unlock (&this->lock);
+            break;
+         }
+         ljspool_append (this->spool, this->timestamp, 0,
+                         1, this->num_registers, this->frame);
+         this->output[0] = (float) (this->timestamp - this->epoch);
+         for (i = 0; i < this->num_registers; i++)
+            this->output[i + 1] = (float) this->frame[i];
+         write_fv (context, linked_channels (context, id),
+                   this->num_registers + 1, this->output);
+         ljmutex_unlock (&this->lock);
+      }
+      break;
+
+   case read_rmcios:
+      if (this == NULL)
+         break;
+      if (num_params > 0)
+      {
+         char keyword[20];
+         param_to_string (context, paramtype, param, 0,
+                          sizeof (keyword), keyword);
+         if (strcmp (keyword, "skew") == 0)
+         {
+            float skew;
+            ljmutex_lock (&this->lock);
+            skew = (float) this->skew;
+            ljmutex_unlock (&this->lock);
+            return_float (context, returnv, skew);
+            break;
+         }
+         if (strcmp (keyword, "errors") == 0)
+         {
+            int errors;
+            ljmutex_lock (&this->lock);
+            errors = this->errors;
+            ljmutex_unlock (&this->lock);
+            return_int (context, returnv, errors);
+            break;
+         }
+      }
+      {
+         float duration;
+         ljmutex_lock (&this->lock);
+         duration = (float) this->duration;
+         ljmutex_unlock (&this->lock);
+         return_float (context, returnv, duration);
       }
       break;
    }
@@ -495,8 +1208,15 @@ void __declspec (dllexport)
      __cdecl init_channels (const struct context_rmcios *context)
 {
    printf ("Labjack ljm module\r\n[" VERSION_STR "]\r\n");
+   ljmutex_init (&ljm_lock);
+   ljtrace_init ();
 
    create_channel_str (context, "ljmdev", (class_rmcios) ljm_device_func, NULL);
    create_channel_str (context, "ljmreg", (class_rmcios) ljm_register_func,
                        NULL);
+   create_channel_str (context, "ljmconv", (class_rmcios) ljconv_func, NULL);
+   create_channel_str (context, "ljmspool", (class_rmcios) ljspool_func, NULL);
+   create_channel_str (context, "ljmtrig", (class_rmcios) ljtrig_func, NULL);
+   create_channel_str (context, "ljmtrace", (class_rmcios) ljtrace_func, NULL);
+   create_channel_str (context, "ljmscan", (class_rmcios) ljm_scan_func, NULL);
 }
@@ -0,0 +1,374 @@
+/*
+RMCIOS - Reactive Multipurpose Control Input Output System
+Copyright (c) 2018 Frans Korhonen
+
+RMIOS was originally developed at Institute for Atmospheric
+and Earth System Research / Physics, Faculty of Science,
+University of Helsinki, Finland
+
+Assistance, experience and feedback from following persons have been
+critical for development of RMCIOS: Erkki Siivola, Juha Kangasluoma,
+Lauri Ahonen, Ella Häkkinen, Pasi Aalto, Joonas Enroth, Runlong Cai,
+Markku Kulmala and Tuukka Petäjä.
+
+This file is extension to RMCIOS. This notice was encoded using utf-8.
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+/**
+ * Traced wrappers for LJM library calls.
+ */
+
+#include <string.h>
+#include "ljm_trace.h"
+#include "ljtrace.h"
+
+#define LJMT_NAME_SIZE 64
+
+// Start time of call when recording
+#define TRACE_START() \
+   (ljtrace_mode == LJTRACE_RECORD ? ljtrace_begin () : 0)
+
+static void copy_name (char *dst, const char *src)
+{
+   strncpy (dst, src, LJMT_NAME_SIZE - 1);
+   dst[LJMT_NAME_SIZE - 1] = 0;
+}
+
+int LJMT_OpenS (const char *DeviceType, const char *ConnectionType,
+                const char *Identifier, int *Handle)
+{
+   struct
+   {
+      char device_type[LJMT_NAME_SIZE];
+      char connection_type[LJMT_NAME_SIZE];
+      char identifier[LJMT_NAME_SIZE];
+      int32_t handle;
+   } p;
+   int32_t err;
+   double start;
+
+   if (ljtrace_mode == LJTRACE_REPLAY)
+   {
+      if (ljtrace_next (LJMT_OPENS, LJTRACE_NO_DEVICE, 0, &err, &p, sizeof (p),
+                        NULL, 0) < 0)
+         return LJTRACE_ERROR;
+      *Handle = p.handle;
+      return err;
+   }
+   start = TRACE_START ();
+   err = LJM_OpenS (DeviceType, ConnectionType, Identifier, Handle);
+   if (ljtrace_mode == LJTRACE_RECORD)
+   {
+      memset (&p, 0, sizeof (p));
+      copy_name (p.device_type, DeviceType);
+      copy_name (p.connection_type, ConnectionType);
+      copy_name (p.identifier, Identifier);
+      p.handle = *Handle;
+      ljtrace_write (LJMT_OPENS, LJTRACE_NO_DEVICE, 0, err, start, &p,
+                     sizeof (p), NULL, 0);
+   }
+   return err;
+}
+
+int LJMT_NameToAddress (const char *Name, int *Address, int *Type)
+{
+   struct
+   {
+      char name[LJMT_NAME_SIZE];
+      int32_t address;
+      int32_t type;
+   } p;
+   int32_t err;
+   double start;
+
+   if (ljtrace_mode == LJTRACE_REPLAY)
+   {
+      if (ljtrace_next (LJMT_NAMETOADDRESS, LJTRACE_NO_DEVICE, 0, &err, &p,
+                        sizeof (p), NULL, 0) < 0)
+         return LJTRACE_ERROR;
+      *Address = p.address;
+      *Type = p.type;
+      return err;
+   }
+   start = TRACE_START ();
+   err = LJM_NameToAddress (Name, Address, Type);
+   if (ljtrace_mode == LJTRACE_RECORD)
+   {
+      memset (&p, 0, sizeof (p));
+      copy_name (p.name, Name);
+      p.address = *Address;
+      p.type = *Type;
+      ljtrace_write (LJMT_NAMETOADDRESS, LJTRACE_NO_DEVICE, 0, err, start, &p,
+                     sizeof (p), NULL, 0);
+   }
+   return err;
+}
+
+int LJMT_AddressToType (int Address, int *Type)
+{
+   struct
+   {
+      int32_t address;
+      int32_t type;
+   } p;
+   int32_t err;
+   double start;
+
+   if (ljtrace_mode == LJTRACE_REPLAY)
+   {
+      if (ljtrace_next (LJMT_ADDRESSTOTYPE, LJTRACE_NO_DEVICE, Address, &err,
+                        &p, sizeof (p), NULL, 0) < 0)
+         return LJTRACE_ERROR;
+      *Type = p.type;
+      return err;
+   }
+   start = TRACE_START ();
+   err = LJM_AddressToType (Address, Type);
+   if (ljtrace_mode == LJTRACE_RECORD)
+   {
+      p.address = Address;
+      p.type = *Type;
+      ljtrace_write (LJMT_ADDRESSTOTYPE, LJTRACE_NO_DEVICE, Address, err,
+                     start, &p, sizeof (p), NULL, 0);
+   }
+   return err;
+}
+
+int LJMT_eReadAddressString (int Handle, int Address, char *String)
+{
+   struct
+   {
+      int32_t handle;
+      int32_t address;
+      char string[LJM_STRING_ALLOCATION_SIZE];
+   } p;
+   int32_t err;
+   double start;
+
+   if (ljtrace_mode == LJTRACE_REPLAY)
+   {
+      if (ljtrace_next (LJMT_EREADADDRESSSTRING, Handle, Address, &err, &p,
+                        sizeof (p), NULL, 0) < 0)
+         return LJTRACE_ERROR;
+      memcpy (String, p.string, LJM_STRING_ALLOCATION_SIZE);
+      return err;
+   }
+   start = TRACE_START ();
+   err = LJM_eReadAddressString (Handle, Address, String);
+   if (ljtrace_mode == LJTRACE_RECORD)
+   {
+      p.handle = Handle;
+      p.address = Address;
+      memcpy (p.string, String, LJM_STRING_ALLOCATION_SIZE);
+      ljtrace_write (LJMT_EREADADDRESSSTRING, Handle, Address, err, start, &p,
+                     sizeof (p), NULL, 0);
+   }
+   return err;
+}
+
+int LJMT_eWriteAddressString (int Handle, int Address, const char *String)
+{
+   struct
+   {
+      int32_t handle;
+      int32_t address;
+      char string[LJM_STRING_ALLOCATION_SIZE];
+   } p;
+   int32_t err;
+   double start;
+
+   if (ljtrace_mode == LJTRACE_REPLAY)
+   {
+      if (ljtrace_next (LJMT_EWRITEADDRESSSTRING, Handle, Address, &err, &p,
+                        sizeof (p), NULL, 0) < 0)
+         return LJTRACE_ERROR;
+      return err;
+   }
+   start = TRACE_START ();
+   err = LJM_eWriteAddressString (Handle, Address, String);
+   if (ljtrace_mode == LJTRACE_RECORD)
+   {
+      memset (&p, 0, sizeof (p));
+      p.handle = Handle;
+      p.address = Address;
+      strncpy (p.string, String, LJM_STRING_ALLOCATION_SIZE - 1);
+      ljtrace_write (LJMT_EWRITEADDRESSSTRING, Handle, Address, err, start, &p,
+                     sizeof (p), NULL, 0);
+   }
+   return err;
+}
+
+struct ljmt_numeric
+{
+   int32_t handle;
+   int32_t address;
+   int32_t type;
+   int32_t reserved;
+   double value;
+};
+
+int LJMT_eReadAddress (int Handle, int Address, int Type, double *Value)
+{
+   struct ljmt_numeric p;
+   int32_t err;
+   double start;
+
+   if (ljtrace_mode == LJTRACE_REPLAY)
+   {
+      if (ljtrace_next (LJMT_EREADADDRESS, Handle, Address, &err, &p,
+                        sizeof (p), NULL, 0) < 0)
+         return LJTRACE_ERROR;
+      *Value = p.value;
+      return err;
+   }
+   start = TRACE_START ();
+   err = LJM_eReadAddress (Handle, Address, Type, Value);
+   if (ljtrace_mode == LJTRACE_RECORD)
+   {
+      p.handle = Handle;
+      p.address = Address;
+      p.type = Type;
+      p.reserved = 0;
+      p.value = *Value;
+      ljtrace_write (LJMT_EREADADDRESS, Handle, Address, err, start, &p,
+                     sizeof (p), NULL, 0);
+   }
+   return err;
+}
+
+int LJMT_eWriteAddress (int Handle, int Address, int Type, double Value)
+{
+   struct ljmt_numeric p;
+   int32_t err;
+   double start;
+
+   if (ljtrace_mode == LJTRACE_REPLAY)
+   {
+      if (ljtrace_next (LJMT_EWRITEADDRESS, Handle, Address, &err, &p,
+                        sizeof (p), NULL, 0) < 0)
+         return LJTRACE_ERROR;
+      return err;
+   }
+   start = TRACE_START ();
+   err = LJM_eWriteAddress (Handle, Address, Type, Value);
+   if (ljtrace_mode == LJTRACE_RECORD)
+   {
+      p.handle = Handle;
+      p.address = Address;
+      p.type = Type;
+      p.reserved = 0;
+      p.value = Value;
+      ljtrace_write (LJMT_EWRITEADDRESS, Handle, Address, err, start, &p,
+                     sizeof (p), NULL, 0);
+   }
+   return err;
+}
+
+struct ljmt_bytes
+{
+   int32_t handle;
+   int32_t address;
+   int32_t num_bytes;
+   int32_t error_address;
+};
+
+int LJMT_eReadAddressByteArray (int Handle, int Address, int NumBytes,
+                                char *aBytes, int *ErrorAddress)
+{
+   struct ljmt_bytes p;
+   int32_t err;
+   double start;
+
+   if (ljtrace_mode == LJTRACE_REPLAY)
+   {
+      if (ljtrace_next (LJMT_EREADADDRESSBYTEARRAY, Handle, Address, &err, &p,
+                        sizeof (p), aBytes, NumBytes) < 0)
+         return LJTRACE_ERROR;
+      *ErrorAddress = p.error_address;
+      return err;
+   }
+   start = TRACE_START ();
+   err = LJM_eReadAddressByteArray (Handle, Address, NumBytes,
+                                    aBytes, ErrorAddress);
+   if (ljtrace_mode == LJTRACE_RECORD)
+   {
+      p.handle = Handle;
+      p.address = Address;
+      p.num_bytes = NumBytes;
+      p.error_address = *ErrorAddress;
+      ljtrace_write (LJMT_EREADADDRESSBYTEARRAY, Handle, Address, err, start,
+                     &p, sizeof (p), aBytes, NumBytes);
+   }
+   return err;
+}
+
+int LJMT_eWriteAddressByteArray (int Handle, int Address, int NumBytes,
+                                 const char *aBytes, int *ErrorAddress)
+{
+   struct ljmt_bytes p;
+   int32_t err;
+   double start;
+
+   if (ljtrace_mode == LJTRACE_REPLAY)
+   {
+      if (ljtrace_next (LJMT_EWRITEADDRESSBYTEARRAY, Handle, Address, &err, &p,
+                        sizeof (p), NULL, 0) < 0)
+         return LJTRACE_ERROR;
+      *ErrorAddress = p.error_address;
+      return err;
+   }
+   start = TRACE_START ();
+   err = LJM_eWriteAddressByteArray (Handle, Address, NumBytes,
+                                     aBytes, ErrorAddress);
+   if (ljtrace_mode == LJTRACE_RECORD)
+   {
+      p.handle = Handle;
+      p.address = Address;
+      p.num_bytes = NumBytes;
+      p.error_address = *ErrorAddress;
+      ljtrace_write (LJMT_EWRITEADDRESSBYTEARRAY, Handle, Address, err, start,
+                     &p, sizeof (p), aBytes, NumBytes);
+   }
+   return err;
+}
+
+int LJMT_eReadAddresses (int Handle, int NumFrames, const int *aAddresses,
+                         const int *aTypes, double *aValues,
+                         int *ErrorAddress)
+{
+   struct
+   {
+      int32_t handle;
+      int32_t num_frames;
+      int32_t error_address;
+   } p;
+   int32_t err;
+   double start;
+   int32_t address = NumFrames > 0 ? aAddresses[0] : 0;
+
+   if (ljtrace_mode == LJTRACE_REPLAY)
+   {
+      if (ljtrace_next (LJMT_EREADADDRESSES, Handle, address, &err, &p,
+                        sizeof (p), aValues, NumFrames * sizeof (double)) < 0)
+         return LJTRACE_ERROR;
+      *ErrorAddress = p.error_address;
+      return err;
+   }
+   start = TRACE_START ();
+   err = LJM_eReadAddresses (Handle, NumFrames, aAddresses, aTypes,
+                             aValues, ErrorAddress);
+   if (ljtrace_mode == LJTRACE_RECORD)
+   {
+      p.handle = Handle;
+      p.num_frames = NumFrames;
+      p.error_address = *ErrorAddress;
+      ljtrace_write (LJMT_EREADADDRESSES, Handle, address, err, start, &p,
+                     sizeof (p), aValues, NumFrames * sizeof (double));
+   }
+   return err;
+}
+
@@ -0,0 +1,43 @@
+/*
+ Traced wrappers for the LJM library calls used by ljm_channels.c.
+ Wrappers call the LJM library directly when tracing is off, record the
+ calls to trace when recording and return recorded results on replay.
+*/
+
+#ifndef ljm_trace_h
+#define ljm_trace_h
+
+#include <LabJackM.h>
+
+enum ljm_trace_call
+{
+   LJMT_OPENS = 1,
+   LJMT_NAMETOADDRESS,
+   LJMT_ADDRESSTOTYPE,
+   LJMT_EREADADDRESSSTRING,
+   LJMT_EWRITEADDRESSSTRING,
+   LJMT_EREADADDRESS,
+   LJMT_EWRITEADDRESS,
+   LJMT_EREADADDRESSBYTEARRAY,
+   LJMT_EWRITEADDRESSBYTEARRAY,
+   LJMT_EREADADDRESSES
+};
+
+int LJMT_OpenS (const char *DeviceType, const char *ConnectionType,
+                const char *Identifier, int *Handle);
+int LJMT_NameToAddress (const char *Name, int *Address, int *Type);
+int LJMT_AddressToType (int Address, int *Type);
+int LJMT_eReadAddressString (int Handle, int Address, char *String);
+int LJMT_eWriteAddressString (int Handle, int Address, const char *String);
+int LJMT_eReadAddress (int Handle, int Address, int Type, double *Value);
+int LJMT_eWriteAddress (int Handle, int Address, int Type, double Value);
+int LJMT_eReadAddressByteArray (int Handle, int Address, int NumBytes,
+                                char *aBytes, int *ErrorAddress);
+int LJMT_eWriteAddressByteArray (int Handle, int Address, int NumBytes,
+                                 const char *aBytes, int *ErrorAddress);
+int LJMT_eReadAddresses (int Handle, int NumFrames, const int *aAddresses,
+                         const int *aTypes, double *aValues,
+                         int *ErrorAddress);
+
+#endif
+
@@ -0,0 +1,558 @@
+/*
+RMCIOS - Reactive Multipurpose Control Input Output System
+Copyright (c) 2018 Frans Korhonen
+
+RMIOS was originally developed at Institute for Atmospheric
+and Earth System Research / Physics, Faculty of Science,
+University of Helsinki, Finland
+
+Assistance, experience and feedback from following persons have been
+critical for development of RMCIOS: Erkki Siivola, Juha Kangasluoma,
+Lauri Ahonen, Ella Häkkinen, Pasi Aalto, Joonas Enroth, Runlong Cai,
+Markku Kulmala and Tuukka Petäjä.
+
+This file is extension to RMCIOS. This notice was encoded using utf-8.
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+/**
+ * Acquisition sink that appends timestamped sample blocks to
+ * preallocated memory mapped segment files. Writes only copy into the
+ * mapping, flushing to disk is left to the operating system so short
+ * disk stalls do not block acquisition.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ljspool.h"
+#include "ljtime.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#endif
+
+static struct ljspool_data *first_spool = NULL;
+
+// Unmap and close segment
+static void ljspool_segment_close (struct ljspool_segment *segment)
+{
+   if (segment->data == NULL)
+      return;
+#ifdef _WIN32
+   UnmapViewOfFile (segment->data);
+   CloseHandle ((HANDLE) segment->mapping);
+   CloseHandle ((HANDLE) segment->file);
+#else
+   munmap (segment->data, segment->size);
+   close ((int) (intptr_t) segment->file);
+#endif
+   segment->data = NULL;
+}
+
+static void ljspool_filename (char *filename, size_t size,
+                              const char *basename, uint32_t index)
+{
+   snprintf (filename, size, "%s_%06u.ljs", basename, (unsigned) index);
+}
+
+// Close and remove prepared segment that never received blocks
+static void ljspool_segment_discard (struct ljspool_segment *segment,
+                                     const char *basename)
+{
+   char filename[LJSPOOL_BASENAME_SIZE + 16];
+   if (segment->data == NULL)
+      return;
+   ljspool_segment_close (segment);
+   ljspool_filename (filename, sizeof (filename), basename, segment->index);
+   remove (filename);
+}
+
+// Segment index from file name prefix_NNNNNN.ljs or -1 if no match
+static long ljspool_name_index (const char *name, const char *prefix)
+{
+   size_t len = strlen (prefix);
+   unsigned index;
+   char tail[8];
+   if (strncmp (name, prefix, len) != 0 || name[len] != '_')
+      return -1;
+   if (sscanf (name + len + 1, "%6u%7s", &index, tail) != 2
+       || strcmp (tail, ".ljs") != 0)
+      return -1;
+   return index;
+}
+
+// Index after the highest existing segment of the basename, so earlier
+// segments are never overwritten.
+static uint32_t ljspool_next_index (const char *basename)
+{
+   long next = 0;
+   long index;
+#ifdef _WIN32
+   char pattern[LJSPOOL_BASENAME_SIZE + 8];
+   const char *prefix = basename;
+   const char *p;
+   WIN32_FIND_DATAA found;
+   HANDLE find;
+   for (p = basename; *p != 0; p++)
+      if (*p == '/' || *p == '\\' || *p == ':')
+         prefix = p + 1;
+   snprintf (pattern, sizeof (pattern), "%s_*.ljs", basename);
+   find = FindFirstFileA (pattern, &found);
+   if (find == INVALID_HANDLE_VALUE)
+      return 0;
+   do
+   {
+      index = ljspool_name_index (found.cFileName, prefix);
+      if (index >= next)
+         next = index + 1;
+   }
+   while (FindNextFileA (find, &found));
+   FindClose (find);
+#else
+   char dirname[LJSPOOL_BASENAME_SIZE];
+   const char *prefix = strrchr (basename, '/');
+   struct dirent *entry;
+   DIR *dir;
+   if (prefix == NULL)
+   {
+      strcpy (dirname, ".");
+      prefix = basename;
+   }
+   else
+   {
+      snprintf (dirname, sizeof (dirname), "%.*s",
+                (int) (prefix - basename), basename);
+      if (dirname[0] == 0)
+         strcpy (dirname, "/");
+      prefix++;
+   }
+   dir = opendir (dirname);
+   if (dir == NULL)
+      return 0;
+   while ((entry = readdir (dir)) != NULL)
+   {
+      index = ljspool_name_index (entry->d_name, prefix);
+      if (index >= next)
+         next = index + 1;
+   }
+   closedir (dir);
+#endif
+   return (uint32_t) next;
+}
+
+// Create, preallocate and map segment file with header. Existing files
+// are never overwritten. Returns 0 on success, LJSPOOL_EXISTS if the
+// file exists and -1 on other errors.
+#define LJSPOOL_EXISTS -2
+static int ljspool_segment_create (struct ljspool_segment *segment,
+                                   const struct ljspool_layout *layout,
+                                   uint32_t index)
+{
+   char filename[LJSPOOL_BASENAME_SIZE + 16];
+   struct ljspool_header *header;
+   struct ljspool_channel_entry *entry;
+   int i;
+
+   ljspool_filename (filename, sizeof (filename), layout->basename, index);
+
+#ifdef _WIN32
+   HANDLE file;
+   HANDLE mapping;
+   file = CreateFileA (filename, GENERIC_READ | GENERIC_WRITE,
+                       FILE_SHARE_READ, NULL, CREATE_NEW,
+                       FILE_ATTRIBUTE_NORMAL, NULL);
+   if (file == INVALID_HANDLE_VALUE)
+   {
+      printf ("spool: Could not create %s\r\n", filename);
+      return GetLastError () == ERROR_FILE_EXISTS ? LJSPOOL_EXISTS : -1;
+   }
+   // Mapping with the full size allocates the file, so a full disk
+   // fails here instead of on a later write
+   mapping = CreateFileMappingA (file, NULL, PAGE_READWRITE,
+                                 (DWORD) (layout->segment_size >> 32),
+                                 (DWORD) layout->segment_size, NULL);
+   if (mapping == NULL)
+   {
+      printf ("spool: Could not map %s\r\n", filename);
+      CloseHandle (file);
+      DeleteFileA (filename);
+      return -1;
+   }
+   segment->data = MapViewOfFile (mapping, FILE_MAP_WRITE, 0, 0, 0);
+   if (segment->data == NULL)
+   {
+      printf ("spool: Could not map %s\r\n", filename);
+      CloseHandle (mapping);
+      CloseHandle (file);
+      DeleteFileA (filename);
+      return -1;
+   }
+   segment->file = file;
+   segment->mapping = mapping;
+#else
+   int fd = open (filename, O_RDWR | O_CREAT | O_EXCL, 0644);
+   if (fd < 0)
+   {
+      printf ("spool: Could not create %s\r\n", filename);
+      return errno == EEXIST ? LJSPOOL_EXISTS : -1;
+   }
+   // Allocate disk blocks now. A sparse file would fault with SIGBUS
+   // when the disk fills under the mapping.
+   if (posix_fallocate (fd, 0, layout->segment_size) != 0)
+   {
+      printf ("spool: Could not preallocate %s\r\n", filename);
+      close (fd);
+      unlink (filename);
+      return -1;
+   }
+   segment->data = mmap (NULL, layout->segment_size,
+                         PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if (segment->data == MAP_FAILED)
+   {
+      printf ("spool: Could not map %s\r\n", filename);
+      segment->data = NULL;
+      close (fd);
+      unlink (filename);
+      return -1;
+   }
+   segment->file = (void *) (intptr_t) fd;
+#endif
+   segment->size = layout->segment_size;
+   segment->index = index;
+
+   // Fixed header and channel table
+   header = (struct ljspool_header *) segment->data;
+   memset (header, 0, sizeof (struct ljspool_header));
+   memcpy (header->magic, LJSPOOL_MAGIC, sizeof (LJSPOOL_MAGIC));
+   header->version = LJSPOOL_VERSION;
+   header->header_size = sizeof (struct ljspool_header)
+      + layout->num_channels * sizeof (struct ljspool_channel_entry);
+   header->segment_size = layout->segment_size;
+   header->num_channels = layout->num_channels;
+   header->segment_index = index;
+   header->monotonic_time = ljtime_monotonic ();
+   header->wall_time = ljtime_wall ();
+   entry = (struct ljspool_channel_entry *) ljspool_channels (segment->data);
+   for (i = 0; i < layout->num_channels; i++)
+      memcpy (entry[i].name, layout->names[i], LJSPOOL_NAME_SIZE);
+   __atomic_store_n (&header->write_offset, header->header_size,
+                     __ATOMIC_RELEASE);
+   return 0;
+}
+
+// Create segment of spool layout at next free index. Updates the
+// index on success or when the file exists. Called with spool lock
+// held, or with a copy of the layout by the preparer.
+static int ljspool_create_next (struct ljspool_segment *segment,
+                                const struct ljspool_layout *layout,
+                                uint32_t *index)
+{
+   int err = ljspool_segment_create (segment, layout, *index);
+   if (err == 0)
+      (*index)++;
+   else if (err == LJSPOOL_EXISTS)
+      *index = ljspool_next_index (layout->basename);
+   return err;
+}
+
+// Background preparation of the next segment. Creating and allocating
+// a segment is slow, so it is kept out of the append path. Full
+// segments are also closed here.
+static LJTHREAD_FUNC (ljspool_preparer, arg)
+{
+   struct ljspool_data *spool = (struct ljspool_data *) arg;
+   struct ljspool_layout *layout;
+   layout = (struct ljspool_layout *) malloc (sizeof (struct ljspool_layout));
+   if (layout == NULL)
+      LJTHREAD_RETURN;
+   for (;;)
+   {
+      struct ljspool_segment retired;
+      struct ljspool_segment segment;
+      unsigned generation;
+      uint32_t index;
+      int needed;
+      int err;
+
+      ljsem_wait (&spool->prepare);
+      ljmutex_lock (&spool->lock);
+      retired = spool->retired;
+      spool->retired.data = NULL;
+      needed = spool->layout.basename[0] != 0 && spool->next.data == NULL;
+      *layout = spool->layout;
+      generation = spool->generation;
+      index = spool->segment_index;
+      ljmutex_unlock (&spool->lock);
+
+      ljspool_segment_close (&retired);
+      segment.data = NULL;
+      err = 0;
+      if (needed)
+         err = ljspool_create_next (&segment, layout, &index);
+
+      ljmutex_lock (&spool->lock);
+      if (spool->generation == generation)
+      {
+         // Setup did not change the layout meanwhile
+         spool->segment_index = index;
+         if (segment.data != NULL && spool->next.data == NULL)
+         {
+            spool->next = segment;
+            segment.data = NULL;
+         }
+      }
+      if (err != 0)
+         spool->retry_time = ljtime_monotonic () + 1;
+      spool->preparing = 0;
+      ljmutex_unlock (&spool->lock);
+      ljspool_segment_discard (&segment, layout->basename);
+   }
+   LJTHREAD_RETURN;
+}
+
+// Start preparing next segment and closing retired segment when
+// needed. Without preparer thread the work is done here. Called with
+// spool lock held.
+static void ljspool_prepare (struct ljspool_data *spool)
+{
+   int needed = spool->layout.basename[0] != 0 && spool->next.data == NULL
+      && ljtime_monotonic () >= spool->retry_time;
+   if (spool->preparing || (!needed && spool->retired.data == NULL))
+      return;
+   if (spool->worker)
+   {
+      spool->preparing = 1;
+      ljsem_post (&spool->prepare);
+      return;
+   }
+   ljspool_segment_close (&spool->retired);
+   if (needed && ljspool_create_next (&spool->next, &spool->layout,
+                                      &spool->segment_index) != 0)
+      spool->retry_time = ljtime_monotonic () + 1;
+}
+
+int ljspool_append (struct ljspool_data *spool,
+                    double timestamp, double interval,
+                    int num_samples, int num_channels, const double *values)
+{
+   struct ljspool_header *header;
+   struct ljspool_block *block;
+   uint64_t size;
+
+   if (spool == NULL || num_samples < 1 || num_channels < 1)
+      return -1;
+   size = sizeof (struct ljspool_block)
+      + (uint64_t) num_samples * num_channels * sizeof (double);
+
+   ljmutex_lock (&spool->lock);
+   if (spool->current.data == NULL)
+   {
+      // Setup could not create the first segment. Continue in the
+      // next segment once it has been prepared.
+      spool->current = spool->next;
+      spool->next.data = NULL;
+      if (spool->current.data == NULL)
+      {
+         spool->dropped++;
+         ljspool_prepare (spool);
+         ljmutex_unlock (&spool->lock);
+         return -1;
+      }
+   }
+   header = (struct ljspool_header *) spool->current.data;
+   if (header->write_offset + size > spool->current.size)
+   {
+      // Rotate to the preallocated next segment. Until it is ready
+      // the current segment is kept and blocks are dropped.
+      if (header->header_size + size > spool->current.size
+          || spool->next.data == NULL)
+      {
+         spool->dropped++;
+         ljspool_prepare (spool);
+         ljmutex_unlock (&spool->lock);
+         return -1;
+      }
+      ljspool_segment_close (&spool->retired);
+      spool->retired = spool->current;
+      spool->current = spool->next;
+      spool->next.data = NULL;
+      header = (struct ljspool_header *) spool->current.data;
+   }
+
+   block = (struct ljspool_block *)
+      (spool->current.data + header->write_offset);
+   block->num_samples = num_samples;
+   block->num_channels = num_channels;
+   block->timestamp = timestamp;
+   block->interval = interval;
+   memcpy (block + 1, values, size - sizeof (struct ljspool_block));
+
+   // Publish the block to readers after its contents
+   __atomic_store_n (&header->write_offset, header->write_offset + size,
+                     __ATOMIC_RELEASE);
+   spool->blocks++;
+   ljspool_prepare (spool);
+   ljmutex_unlock (&spool->lock);
+   return 0;
+}
+
+struct ljspool_data *ljspool_find (int channel_id)
+{
+   struct ljspool_data *pspool = first_spool;
+   while (pspool != NULL)
+   {
+      if (pspool->channel_id == channel_id)
+         return pspool;
+      pspool = pspool->next_spool;
+   }
+   return NULL;
+}
+
+// Channel for spooling samples to segment files
+void ljspool_func (struct ljspool_data *this,
+                   const struct context_rmcios *context, int id,
+                   enum function_rmcios function,
+                   enum type_rmcios paramtype,
+                   struct combo_rmcios *returnv,
+                   int num_params, const union param_rmcios param)
+{
+   switch (function)
+   {
+   case help_rmcios:
+      return_string (context, returnv,
+                     "labjack spool channel"
+                     " - memory mapped acquisition block spool\r\n"
+                     " create ljmspool/ljspool newname\r\n"
+                     " setup newname file_basename | segment_size_MB(64)\r\n"
+                     "       | channel_name1 | channel_name2 ...\r\n"
+                     "   #Segments are named file_basename_NNNNNN.ljs\r\n"
+                     "   #and rotated when full.\r\n"
+                     " write newname value1 | value2 ...\r\n"
+                     "   #Append one timestamped row\r\n"
+                     " read newname #Read number of blocks written\r\n"
+                     " read newname dropped #Read number of dropped blocks\r\n");
+      break;
+
+   case create_rmcios:
+      if (num_params < 1)
+         break;
+      // Allocate new data:
+      this = (struct ljspool_data *) malloc (sizeof (struct ljspool_data));
+      if (this == NULL)
+         break;
+
+      // Set default values:
+      memset (this, 0, sizeof (struct ljspool_data));
+      this->layout.segment_size = 64 * 1024 * 1024;
+      this->current.data = NULL;
+      this->next.data = NULL;
+      this->retired.data = NULL;
+      ljmutex_init (&this->lock);
+      ljsem_init (&this->prepare);
+      this->worker =
+         ljthread_start (&this->thread, ljspool_preparer, this) == 0;
+
+      // Create the channel
+      this->channel_id =
+         create_channel_param (context, paramtype, param, 0,
+                               (class_rmcios) ljspool_func, this);
+
+      // Add spool to list of spools:
+      this->next_spool = first_spool;
+      first_spool = this;
+      break;
+
+   case setup_rmcios:
+      if (this == NULL)
+         break;
+      if (num_params < 1)
+         break;
+      {
+         struct ljspool_layout *layout = &this->layout;
+         int i;
+         ljmutex_lock (&this->lock);
+         // Segments of the previous layout are closed first. An unused
+         // preallocated segment is removed.
+         ljspool_segment_close (&this->current);
+         ljspool_segment_close (&this->retired);
+         ljspool_segment_discard (&this->next, layout->basename);
+         this->generation++;
+
+         param_to_string (context, paramtype, param, 0,
+                          sizeof (layout->basename), layout->basename);
+         if (num_params > 1)
+         {
+            int megabytes = param_to_int (context, paramtype, param, 1);
+            if (megabytes > 0)
+               layout->segment_size = (uint64_t) megabytes * 1024 * 1024;
+         }
+         layout->num_channels = 0;
+         for (i = 2; i < num_params
+              && layout->num_channels < LJSPOOL_MAX_CHANNELS; i++)
+         {
+            param_to_string (context, paramtype, param, i,
+                             LJSPOOL_NAME_SIZE,
+                             layout->names[layout->num_channels]);
+            layout->num_channels++;
+         }
+         this->segment_index = ljspool_next_index (layout->basename);
+         this->retry_time = 0;
+         ljspool_create_next (&this->current, layout, &this->segment_index);
+         ljspool_prepare (this);
+         ljmutex_unlock (&this->lock);
+      }
+      break;
+
+   case write_rmcios:
+      if (this == NULL)
+         break;
+      if (num_params < 1)
+         break;
+      {
+         double values[num_params];
+         int i;
+         for (i = 0; i < num_params; i++)
+            values[i] = param_to_float (context, paramtype, param, i);
+         ljspool_append (this, ljtime_monotonic (), 0, 1, num_params, values);
+      }
+      break;
+
+   case read_rmcios:
+      if (this == NULL)
+         break;
+      if (num_params > 0)
+      {
+         char keyword[20];
+         param_to_string (context, paramtype, param, 0,
+                          sizeof (keyword), keyword);
+         if (strcmp (keyword, "dropped") == 0)
+         {
+            int dropped;
+            ljmutex_lock (&this->lock);
+            dropped = (int) this->dropped;
+            ljmutex_unlock (&this->lock);
+            return_int (context, returnv, dropped);
+            break;
+         }
+      }
+      {
+         int blocks;
+         ljmutex_lock (&this->lock);
+         blocks = (int) this->blocks;
+         ljmutex_unlock (&this->lock);
+         return_int (context, returnv, blocks);
+      }
+      break;
+   }
+}
+
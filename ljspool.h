@@ -0,0 +1,161 @@
+/*
+ Memory mapped segment file spool for labjack acquisition blocks.
+
+ Segment file layout (byte order and double format of the writer):
+   struct ljspool_header
+   struct ljspool_channel_entry[num_channels]
+   blocks from header_size up to write_offset:
+      struct ljspool_block
+      double values[num_samples][num_channels]
+
+ The writer publishes a block by advancing write_offset after the block
+ data is in place, so a reader may map the same file and walk blocks
+ up to write_offset without copying. Readers on a machine of different
+ byte order have to swap the fields.
+*/
+
+#ifndef ljspool_h
+#define ljspool_h
+
+#include <stdint.h>
+#include "RMCIOS-functions.h"
+#include "ljthread.h"
+
+#define LJSPOOL_MAGIC "LJSPOOL"
+#define LJSPOOL_VERSION 1
+#define LJSPOOL_NAME_SIZE 32
+#define LJSPOOL_MAX_CHANNELS 64
+#define LJSPOOL_BASENAME_SIZE 256
+
+struct ljspool_header
+{
+   char magic[8];
+   uint32_t version;
+   uint32_t header_size;        // Offset of the first block
+   uint64_t segment_size;       // Preallocated size of the file
+   uint64_t write_offset;       // End of the last complete block
+   uint32_t num_channels;
+   uint32_t segment_index;
+   double wall_time;            // Wall clock time at monotonic_time
+   double monotonic_time;       // Time base of block timestamps
+   uint32_t reserved[2];
+};
+
+struct ljspool_channel_entry
+{
+   char name[LJSPOOL_NAME_SIZE];
+};
+
+struct ljspool_block
+{
+   uint32_t num_samples;        // Rows in block
+   uint32_t num_channels;       // Values per row
+   double timestamp;            // Monotonic time of the first row
+   double interval;             // Seconds between rows (0 if unknown)
+};
+
+// Segment file settings, copied when segments are prepared
+struct ljspool_layout
+{
+   char basename[LJSPOOL_BASENAME_SIZE];
+   uint64_t segment_size;
+   int num_channels;
+   char names[LJSPOOL_MAX_CHANNELS][LJSPOOL_NAME_SIZE];
+};
+
+// Mapped segment file
+struct ljspool_segment
+{
+   char *data;                  // Mapping, NULL when closed
+   uint64_t size;               // Mapped length
+   uint32_t index;              // Segment file number
+   void *file;                  // Platform file handle
+   void *mapping;               // Platform mapping handle
+};
+
+struct ljspool_data
+{
+   int channel_id;
+   struct ljspool_layout layout;
+   uint32_t segment_index;      // Number of next segment file to create
+   unsigned generation;         // Changed by setup
+   struct ljspool_segment current;      // Segment receiving blocks
+   struct ljspool_segment next;         // Preallocated next segment
+   struct ljspool_segment retired;      // Full segment waiting for close
+   uint64_t blocks;             // Blocks written in total
+   uint64_t dropped;            // Blocks that could not be written
+   ljmutex_t lock;              // Serializes appends and setup
+   int worker;                  // Preparer thread is running
+   int preparing;               // Preparer has been woken
+   double retry_time;           // Earliest retry of failed preparation
+   ljthread_t thread;
+   ljsem_t prepare;             // Wakes the preparer
+   struct ljspool_data *next_spool;
+};
+
+// Append block of num_samples rows of num_channels values.
+// Appends from several threads are serialized. Full segments are
+// rotated to the next segment that is preallocated in the background.
+// Returns 0 on success.
+int ljspool_append (struct ljspool_data *spool,
+                    double timestamp, double interval,
+                    int num_samples, int num_channels, const double *values);
+
+// Find spool channel by its channel id. Returns NULL if not found.
+struct ljspool_data *ljspool_find (int channel_id);
+
+// Channel for spooling samples to segment files
+void ljspool_func (struct ljspool_data *this,
+                   const struct context_rmcios *context, int id,
+                   enum function_rmcios function,
+                   enum type_rmcios paramtype,
+                   struct combo_rmcios *returnv,
+                   int num_params, const union param_rmcios param);
+
+// Reader helpers for a mapped segment:
+
+static inline const struct ljspool_channel_entry *
+ljspool_channels (const void *segment)
+{
+   return (const struct ljspool_channel_entry *)
+      ((const char *) segment + sizeof (struct ljspool_header));
+}
+
+static inline uint64_t ljspool_block_size (const struct ljspool_block *block)
+{
+   return sizeof (struct ljspool_block)
+      + (uint64_t) block->num_samples * block->num_channels * sizeof (double);
+}
+
+// First complete block or NULL if none
+static inline const struct ljspool_block *
+ljspool_first_block (const void *segment)
+{
+   const struct ljspool_header *header = segment;
+   if (__atomic_load_n (&header->write_offset, __ATOMIC_ACQUIRE)
+       <= header->header_size)
+      return NULL;
+   return (const struct ljspool_block *)
+      ((const char *) segment + header->header_size);
+}
+
+// Next complete block or NULL when no more written blocks
+static inline const struct ljspool_block *
+ljspool_next_block (const void *segment, const struct ljspool_block *block)
+{
+   const struct ljspool_header *header = segment;
+   uint64_t offset = (const char *) block - (const char *) segment
+      + ljspool_block_size (block);
+   if (offset >= __atomic_load_n (&header->write_offset, __ATOMIC_ACQUIRE))
+      return NULL;
+   return (const struct ljspool_block *) ((const char *) segment + offset);
+}
+
+static inline const double *ljspool_block_values (const struct ljspool_block
+                                                  *block)
+{
+   return (const double *) (block + 1);
+}
+
+#endif
+
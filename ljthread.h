@@ -0,0 +1,175 @@
+/*
+ Portable thread and lock helpers for labjack modules.
+*/
+
+#ifndef ljthread_h
+#define ljthread_h
+
+#ifdef _WIN32
+#include <windows.h>
+
+typedef HANDLE ljthread_t;
+typedef CRITICAL_SECTION ljmutex_t;
+
+// Define thread function: LJTHREAD_FUNC (name, arg) { ... LJTHREAD_RETURN; }
+#define LJTHREAD_FUNC(name, arg) DWORD WINAPI name (LPVOID arg)
+#define LJTHREAD_RETURN return 0
+
+static inline int ljthread_start (ljthread_t * thread,
+                                  LPTHREAD_START_ROUTINE func, void *arg)
+{
+   *thread = CreateThread (NULL, 0, func, arg, 0, NULL);
+   return *thread == NULL ? -1 : 0;
+}
+
+static inline void ljthread_join (ljthread_t thread)
+{
+   WaitForSingleObject (thread, INFINITE);
+   CloseHandle (thread);
+}
+
+static inline void ljmutex_init (ljmutex_t * mutex)
+{
+   InitializeCriticalSection (mutex);
+}
+
+static inline void ljmutex_lock (ljmutex_t * mutex)
+{
+   EnterCriticalSection (mutex);
+}
+
+static inline void ljmutex_unlock (ljmutex_t * mutex)
+{
+   LeaveCriticalSection (mutex);
+}
+
+// Returns nonzero when lock was taken without waiting
+static inline int ljmutex_trylock (ljmutex_t * mutex)
+{
+   return TryEnterCriticalSection (mutex) != 0;
+}
+
+typedef HANDLE ljsem_t;
+
+// Counting semaphore with zero initial count
+static inline void ljsem_init (ljsem_t * sem)
+{
+   *sem = CreateSemaphore (NULL, 0, 0x7fffffff, NULL);
+}
+
+static inline void ljsem_destroy (ljsem_t * sem)
+{
+   CloseHandle (*sem);
+}
+
+static inline void ljsem_post (ljsem_t * sem)
+{
+   ReleaseSemaphore (*sem, 1, NULL);
+}
+
+static inline void ljsem_wait (ljsem_t * sem)
+{
+   WaitForSingleObject (*sem, INFINITE);
+}
+
+#else
+#include <pthread.h>
+#include <semaphore.h>
+
+typedef pthread_t ljthread_t;
+typedef pthread_mutex_t ljmutex_t;
+
+// Define thread function: LJTHREAD_FUNC (name, arg) { ... LJTHREAD_RETURN; }
+#define LJTHREAD_FUNC(name, arg) void *name (void *arg)
+#define LJTHREAD_RETURN return NULL
+
+static inline int ljthread_start (ljthread_t * thread,
+                                  void *(*func) (void *), void *arg)
+{
+   return pthread_create (thread, NULL, func, arg) == 0 ? 0 : -1;
+}
+
+static inline void ljthread_join (ljthread_t thread)
+{
+   pthread_join (thread, NULL);
+}
+
+static inline void ljmutex_init (ljmutex_t * mutex)
+{
+   pthread_mutex_init (mutex, NULL);
+}
+
+static inline void ljmutex_lock (ljmutex_t * mutex)
+{
+   pthread_mutex_lock (mutex);
+}
+
+static inline void ljmutex_unlock (ljmutex_t * mutex)
+{
+   pthread_mutex_unlock (mutex);
+}
+
+// Returns nonzero when lock was taken without waiting
+static inline int ljmutex_trylock (ljmutex_t * mutex)
+{
+   return pthread_mutex_trylock (mutex) == 0;
+}
+
+typedef sem_t ljsem_t;
+
+// Counting semaphore with zero initial count
+static inline void ljsem_init (ljsem_t * sem)
+{
+   sem_init (sem, 0, 0);
+}
+
+static inline void ljsem_destroy (ljsem_t * sem)
+{
+   sem_destroy (sem);
+}
+
+static inline void ljsem_post (ljsem_t * sem)
+{
+   sem_post (sem);
+}
+
+static inline void ljsem_wait (ljsem_t * sem)
+{
+   // Retry when interrupted by a signal
+   while (sem_wait (sem) != 0) ;
+}
+
+#endif
+
+// Sequence lock for publishing values to readers without locking.
+// Writers of the same sequence must be serialized. Readers retry:
+//    do { seq = ljseq_read_begin (&s); copy values; }
+//    while (ljseq_read_retry (&s, seq));
+typedef unsigned ljseq_t;
+
+static inline void ljseq_write_begin (ljseq_t * seq)
+{
+   __atomic_store_n (seq, *seq + 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence (__ATOMIC_RELEASE);
+}
+
+static inline void ljseq_write_end (ljseq_t * seq)
+{
+   __atomic_store_n (seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+static inline unsigned ljseq_read_begin (const ljseq_t * seq)
+{
+   unsigned s;
+   // Odd sequence means write in progress
+   while ((s = __atomic_load_n (seq, __ATOMIC_ACQUIRE)) & 1) ;
+   return s;
+}
+
+static inline int ljseq_read_retry (const ljseq_t * seq, unsigned s)
+{
+   __atomic_thread_fence (__ATOMIC_ACQUIRE);
+   return __atomic_load_n (seq, __ATOMIC_RELAXED) != s;
+}
+
+#endif
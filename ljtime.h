@@ -0,0 +1,74 @@
+/*
+ Host clock helpers for timestamping labjack samples.
+*/
+
+#ifndef ljtime_h
+#define ljtime_h
+
+#ifdef _WIN32
+#include <windows.h>
+
+// Monotonic time in seconds
+static inline double ljtime_monotonic (void)
+{
+   static LARGE_INTEGER frequency;
+   LARGE_INTEGER counter;
+   if (frequency.QuadPart == 0)
+      QueryPerformanceFrequency (&frequency);
+   QueryPerformanceCounter (&counter);
+   return (double) counter.QuadPart / (double) frequency.QuadPart;
+}
+
+// Wall clock time in seconds since 1970-01-01 UTC
+static inline double ljtime_wall (void)
+{
+   FILETIME ft;
+   ULARGE_INTEGER t;
+   GetSystemTimeAsFileTime (&ft);
+   t.LowPart = ft.dwLowDateTime;
+   t.HighPart = ft.dwHighDateTime;
+   // FILETIME counts 100ns intervals since 1601-01-01
+   return (double) (t.QuadPart - 116444736000000000ULL) / 1e7;
+}
+
+// Sleep for given seconds
+static inline void ljtime_sleep (double seconds)
+{
+   if (seconds > 0)
+      Sleep ((DWORD) (seconds * 1000));
+}
+
+#else
+#include <time.h>
+
+// Monotonic time in seconds
+static inline double ljtime_monotonic (void)
+{
+   struct timespec ts;
+   clock_gettime (CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Wall clock time in seconds since 1970-01-01 UTC
+static inline double ljtime_wall (void)
+{
+   struct timespec ts;
+   clock_gettime (CLOCK_REALTIME, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Sleep for given seconds
+static inline void ljtime_sleep (double seconds)
+{
+   struct timespec ts;
+   if (seconds <= 0)
+      return;
+   ts.tv_sec = (time_t) seconds;
+   ts.tv_nsec = (long) ((seconds - ts.tv_sec) * 1e9);
+   nanosleep (&ts, NULL);
+}
+
+#endif
+
+#endif
+
@@ -0,0 +1,432 @@
+/*
+RMCIOS - Reactive Multipurpose Control Input Output System
+Copyright (c) 2018 Frans Korhonen
+
+RMIOS was originally developed at Institute for Atmospheric
+and Earth System Research / Physics, Faculty of Science,
+University of Helsinki, Finland
+
+Assistance, experience and feedback from following persons have been
+critical for development of RMCIOS: Erkki Siivola, Juha Kangasluoma,
+Lauri Ahonen, Ella Häkkinen, Pasi Aalto, Joonas Enroth, Runlong Cai,
+Markku Kulmala and Tuukka Petäjä.
+
+This file is extension to RMCIOS. This notice was encoded using utf-8.
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+/**
+ * Binary trace of driver calls. Recording stores arguments, results
+ * and timing of each call. Replay returns the recorded results with
+ * original or accelerated timing, without the hardware.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ljtrace.h"
+#include "ljtime.h"
+#include "ljthread.h"
+
+enum ljtrace_mode ljtrace_mode = LJTRACE_OFF;
+
+// Recorded call read ahead from the trace but not replayed yet
+struct ljtrace_pending
+{
+   struct ljtrace_record record;
+   struct ljtrace_pending *next;
+   unsigned char *payload;      // Payload followed by data
+};
+
+// Recorded calls of one call id, device and address in recorded order.
+// Concurrent devices and adaptive polling do not keep the order of
+// calls between streams, so each stream is replayed separately.
+struct ljtrace_stream
+{
+   uint16_t call;
+   int32_t device;
+   int32_t address;
+   int mismatch;                // Replay asked for more than recorded
+   struct ljtrace_pending *first;
+   struct ljtrace_pending *last;
+   struct ljtrace_stream *next;
+};
+
+static FILE *trace_file = NULL;
+static double trace_start;      // Monotonic time of trace start
+static double trace_speed = 1;  // Replay speed factor. 0 = no waiting
+static unsigned long trace_records = 0;
+static int trace_end = 0;       // Whole trace is read to streams
+static struct ljtrace_stream *trace_streams = NULL;
+static ljmutex_t trace_lock;    // Serializes trace file access
+
+void ljtrace_init (void)
+{
+   ljmutex_init (&trace_lock);
+}
+
+// Called with trace_lock held
+static void ljtrace_close (void)
+{
+   while (trace_streams != NULL)
+   {
+      struct ljtrace_stream *stream = trace_streams;
+      while (stream->first != NULL)
+      {
+         struct ljtrace_pending *pending = stream->first;
+         stream->first = pending->next;
+         free (pending->payload);
+         free (pending);
+      }
+      trace_streams = stream->next;
+      free (stream);
+   }
+   if (trace_file != NULL)
+      fclose (trace_file);
+   trace_file = NULL;
+   trace_end = 0;
+   ljtrace_mode = LJTRACE_OFF;
+}
+
+// Called with trace_lock held
+static int ljtrace_record_open (const char *filename)
+{
+   struct ljtrace_file_header header;
+
+   ljtrace_close ();
+   trace_file = fopen (filename, "wb");
+   if (trace_file == NULL)
+   {
+      printf ("trace: Could not create %s\r\n", filename);
+      return -1;
+   }
+   memset (&header, 0, sizeof (header));
+   memcpy (header.magic, LJTRACE_MAGIC, sizeof (LJTRACE_MAGIC));
+   header.version = LJTRACE_VERSION;
+   fwrite (&header, sizeof (header), 1, trace_file);
+
+   trace_start = ljtime_monotonic ();
+   trace_records = 0;
+   ljtrace_mode = LJTRACE_RECORD;
+   return 0;
+}
+
+// Called with trace_lock held
+static int ljtrace_replay_open (const char *filename, double speed)
+{
+   struct ljtrace_file_header header;
+
+   ljtrace_close ();
+   trace_file = fopen (filename, "rb");
+   if (trace_file == NULL)
+   {
+      printf ("trace: Could not open %s\r\n", filename);
+      return -1;
+   }
+   if (fread (&header, sizeof (header), 1, trace_file) != 1
+       || memcmp (header.magic, LJTRACE_MAGIC, sizeof (LJTRACE_MAGIC)) != 0
+       || header.version != LJTRACE_VERSION)
+   {
+      printf ("trace: %s is not a trace file\r\n", filename);
+      ljtrace_close ();
+      return -1;
+   }
+
+   trace_start = ljtime_monotonic ();
+   trace_speed = speed;
+   trace_records = 0;
+   ljtrace_mode = LJTRACE_REPLAY;
+   return 0;
+}
+
+double ljtrace_begin (void)
+{
+   return ljtime_monotonic ();
+}
+
+void ljtrace_write (uint16_t call, int32_t device, int32_t address,
+                    int32_t result, double start,
+                    const void *payload, int size,
+                    const void *data, int data_size)
+{
+   struct ljtrace_record record;
+   if (ljtrace_mode != LJTRACE_RECORD)
+      return;
+   if (data == NULL || data_size < 0)
+      data_size = 0;
+   record.call = call;
+   record.size = size;
+   record.result = result;
+   record.data_size = data_size;
+   record.device = device;
+   record.address = address;
+   record.reserved = 0;
+   record.start = start - trace_start;
+   record.duration = ljtime_monotonic () - start;
+   ljmutex_lock (&trace_lock);
+   if (ljtrace_mode == LJTRACE_RECORD && trace_file != NULL)
+   {
+      fwrite (&record, sizeof (record), 1, trace_file);
+      fwrite (payload, size, 1, trace_file);
+      if (data_size > 0)
+         fwrite (data, data_size, 1, trace_file);
+      trace_records++;
+   }
+   ljmutex_unlock (&trace_lock);
+}
+
+// Find stream of call. Missing stream is created when create is
+// nonzero. Called with trace_lock held.
+static struct ljtrace_stream *ljtrace_stream (uint16_t call, int32_t device,
+                                              int32_t address, int create)
+{
+   struct ljtrace_stream *stream;
+   for (stream = trace_streams; stream != NULL; stream = stream->next)
+   {
+      if (stream->call == call && stream->device == device
+          && stream->address == address)
+         return stream;
+   }
+   if (!create)
+      return NULL;
+   stream = (struct ljtrace_stream *) malloc (sizeof (struct ljtrace_stream));
+   if (stream == NULL)
+      return NULL;
+   stream->call = call;
+   stream->device = device;
+   stream->address = address;
+   stream->mismatch = 0;
+   stream->first = NULL;
+   stream->last = NULL;
+   stream->next = trace_streams;
+   trace_streams = stream;
+   return stream;
+}
+
+// Read next record of the trace file to the end of its stream.
+// Returns nonzero when a record was read. Called with trace_lock held.
+static int ljtrace_read_ahead (void)
+{
+   struct ljtrace_pending *pending;
+   struct ljtrace_stream *stream;
+   uint32_t length;
+
+   if (trace_end)
+      return 0;
+   pending = (struct ljtrace_pending *)
+      malloc (sizeof (struct ljtrace_pending));
+   if (pending == NULL)
+      return 0;
+   pending->next = NULL;
+   pending->payload = NULL;
+   if (fread (&pending->record, sizeof (pending->record), 1, trace_file) != 1)
+   {
+      printf ("trace: End of trace\r\n");
+      trace_end = 1;
+      free (pending);
+      return 0;
+   }
+   length = pending->record.size + pending->record.data_size;
+   if (length > 0)
+      pending->payload = (unsigned char *) malloc (length);
+   stream = ljtrace_stream (pending->record.call, pending->record.device,
+                            pending->record.address, 1);
+   if ((length > 0 && pending->payload == NULL) || stream == NULL
+       || (length > 0 && fread (pending->payload, 1, length, trace_file)
+           != length))
+   {
+      printf ("trace: Could not read trace record\r\n");
+      trace_end = 1;
+      free (pending->payload);
+      free (pending);
+      return 0;
+   }
+   if (stream->last != NULL)
+      stream->last->next = pending;
+   else
+      stream->first = pending;
+   stream->last = pending;
+   return 1;
+}
+
+// Report first mismatch of each device. Called with trace_lock held.
+static void ljtrace_mismatch (struct ljtrace_stream *stream)
+{
+   struct ljtrace_stream *s;
+   if (stream->mismatch)
+      return;
+   for (s = trace_streams; s != NULL; s = s->next)
+   {
+      if (s->device == stream->device && s->mismatch)
+         break;
+   }
+   stream->mismatch = 1;
+   if (s != NULL)
+      return;
+   if (stream->device == LJTRACE_NO_DEVICE)
+      printf ("trace: No recorded call %u left for address %ld\r\n",
+              (unsigned) stream->call, (long) stream->address);
+   else
+      printf ("trace: No recorded call %u left for device %ld"
+              " address %ld\r\n", (unsigned) stream->call,
+              (long) stream->device, (long) stream->address);
+}
+
+// Copy n bytes of stored part of size bytes
+static int copy_part (void *buffer, int n, const unsigned char *part,
+                      uint32_t size)
+{
+   if (n < 0 || buffer == NULL)
+      n = 0;
+   if ((uint32_t) n > size)
+      n = size;
+   if (n > 0)
+      memcpy (buffer, part, n);
+   return n;
+}
+
+int ljtrace_next (uint16_t call, int32_t device, int32_t address,
+                  int32_t * result,
+                  void *payload, int size, void *data, int data_size)
+{
+   struct ljtrace_pending *pending;
+   struct ljtrace_stream *stream;
+   struct ljtrace_record record;
+   double start;
+   double speed;
+   int n;
+
+   if (ljtrace_mode != LJTRACE_REPLAY)
+      return -1;
+   ljmutex_lock (&trace_lock);
+   if (ljtrace_mode != LJTRACE_REPLAY || trace_file == NULL)
+   {
+      ljmutex_unlock (&trace_lock);
+      return -1;
+   }
+   stream = ljtrace_stream (call, device, address, 1);
+   if (stream == NULL)
+   {
+      ljmutex_unlock (&trace_lock);
+      return -1;
+   }
+   // Read ahead until the stream has a call. Calls of other streams
+   // wait for their own replay.
+   while (stream->first == NULL && ljtrace_read_ahead ());
+   pending = stream->first;
+   if (pending == NULL)
+   {
+      // Other devices continue the replay
+      ljtrace_mismatch (stream);
+      ljmutex_unlock (&trace_lock);
+      return -1;
+   }
+   stream->first = pending->next;
+   if (stream->first == NULL)
+      stream->last = NULL;
+
+   record = pending->record;
+   n = 0;
+   if (pending->payload != NULL)
+   {
+      copy_part (payload, size, pending->payload, record.size);
+      n = copy_part (data, data_size, pending->payload + record.size,
+                     record.data_size);
+   }
+   free (pending->payload);
+   free (pending);
+   trace_records++;
+   start = trace_start;
+   speed = trace_speed;
+   ljmutex_unlock (&trace_lock);
+
+   // Reproduce call start and duration with speed factor
+   if (speed > 0)
+   {
+      double now = ljtime_monotonic () - start;
+      ljtime_sleep (record.start / speed - now);
+      ljtime_sleep (record.duration / speed);
+   }
+   *result = record.result;
+   return n;
+}
+
+// Channel for controlling trace recording and replay
+void ljtrace_func (void *this,
+                   const struct context_rmcios *context, int id,
+                   enum function_rmcios function,
+                   enum type_rmcios paramtype,
+                   struct combo_rmcios *returnv,
+                   int num_params, const union param_rmcios param)
+{
+   switch (function)
+   {
+   case help_rmcios:
+      return_string (context, returnv,
+                     "labjack driver trace channel\r\n"
+                     " setup ljmtrace/ljtrace record filename\r\n"
+                     "   #Record driver calls to binary trace\r\n"
+                     " setup ljmtrace/ljtrace replay filename | speed(1)\r\n"
+                     "   #Replay driver calls from trace instead of\r\n"
+                     "   #the driver. speed 0 replays without waiting\r\n"
+                     " setup ljmtrace/ljtrace off\r\n"
+                     " read ljmtrace/ljtrace #read handled call records\r\n"
+                     " Configure replay before opening devices.\r\n");
+      break;
+
+   case setup_rmcios:
+      if (num_params < 1)
+         break;
+      {
+         char mode[20];
+         char filename[256];
+         param_to_string (context, paramtype, param, 0, sizeof (mode), mode);
+         if (strcmp (mode, "off") == 0)
+         {
+            ljmutex_lock (&trace_lock);
+            ljtrace_close ();
+            ljmutex_unlock (&trace_lock);
+            break;
+         }
+         if (num_params < 2)
+            break;
+         param_to_string (context, paramtype, param, 1,
+                          sizeof (filename), filename);
+         if (strcmp (mode, "record") == 0)
+         {
+            ljmutex_lock (&trace_lock);
+            ljtrace_record_open (filename);
+            ljmutex_unlock (&trace_lock);
+         }
+         else if (strcmp (mode, "replay") == 0)
+         {
+            double speed = 1;
+            if (num_params > 2)
+               speed = param_to_float (context, paramtype, param, 2);
+            ljmutex_lock (&trace_lock);
+            ljtrace_replay_open (filename, speed);
+            ljmutex_unlock (&trace_lock);
+         }
+         else
+            printf ("trace: Unknown mode %s\r\n", mode);
+      }
+      break;
+
+   case read_rmcios:
+      {
+         int records;
+         ljmutex_lock (&trace_lock);
+         records = (int) trace_records;
+         ljmutex_unlock (&trace_lock);
+         return_int (context, returnv, records);
+      }
+      break;
+
+   default:
+      break;
+   }
+}
+
@@ -0,0 +1,81 @@
+/*
+ Driver call trace recording and replay for labjack modules.
+
+ Trace file layout (native byte order):
+   struct ljtrace_file_header
+   records:
+      struct ljtrace_record
+      unsigned char payload[size]   // call arguments and results
+      unsigned char data[data_size] // variable length call data
+*/
+
+#ifndef ljtrace_h
+#define ljtrace_h
+
+#include <stdint.h>
+#include "RMCIOS-functions.h"
+
+#define LJTRACE_MAGIC "LJTRACE"
+#define LJTRACE_VERSION 2
+#define LJTRACE_ERROR -1        // Returned by calls that replay fails for
+#define LJTRACE_NO_DEVICE INT32_MIN     // Device of calls without device
+
+enum ljtrace_mode
+{
+   LJTRACE_OFF = 0,
+   LJTRACE_RECORD,
+   LJTRACE_REPLAY
+};
+
+struct ljtrace_file_header
+{
+   char magic[8];
+   uint32_t version;
+   uint32_t reserved;
+};
+
+struct ljtrace_record
+{
+   uint16_t call;               // Call id defined by the module
+   uint16_t size;               // Payload bytes following the record
+   int32_t result;              // Return value of the call
+   uint32_t data_size;          // Data bytes following the payload
+   int32_t device;              // Device handle or idnum of the call
+   int32_t address;             // Register address or channel of the call
+   uint32_t reserved;
+   double start;                // Seconds from start of the trace
+   double duration;             // Seconds spent in the call
+};
+
+extern enum ljtrace_mode ljtrace_mode;
+
+// Initialize trace state. Called once at module init.
+void ljtrace_init (void);
+
+// Start time for a call that is recorded
+double ljtrace_begin (void);
+
+// Record finished call. Data is optional variable length part.
+void ljtrace_write (uint16_t call, int32_t device, int32_t address,
+                    int32_t result, double start,
+                    const void *payload, int size,
+                    const void *data, int data_size);
+
+// Read next replayed call with same call id, device and address into
+// payload, data and result. Calls of different devices and addresses
+// may be replayed in different order than recorded. Waits for the
+// recorded timing. Returns data size or -1 if trace has no such call.
+int ljtrace_next (uint16_t call, int32_t device, int32_t address,
+                  int32_t * result,
+                  void *payload, int size, void *data, int data_size);
+
+// Channel for controlling trace recording and replay
+void ljtrace_func (void *this,
+                   const struct context_rmcios *context, int id,
+                   enum function_rmcios function,
+                   enum type_rmcios paramtype,
+                   struct combo_rmcios *returnv,
+                   int num_params, const union param_rmcios param);
+
+#endif
+
@@ -0,0 +1,395 @@
+/*
+RMCIOS - Reactive Multipurpose Control Input Output System
+Copyright (c) 2018 Frans Korhonen
+
+RMIOS was originally developed at Institute for Atmospheric
+and Earth System Research / Physics, Faculty of Science,
+University of Helsinki, Finland
+
+Assistance, experience and feedback from following persons have been
+critical for development of RMCIOS: Erkki Siivola, Juha Kangasluoma,
+Lauri Ahonen, Ella Häkkinen, Pasi Aalto, Joonas Enroth, Runlong Cai,
+Markku Kulmala and Tuukka Petäjä.
+
+This file is extension to RMCIOS. This notice was encoded using utf-8.
+
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+*/
+
+/**
+ * Triggered capture channel. Keeps circular pre-trigger history and
+ * emits a single snapshot of pre and post trigger samples when a level
+ * or edge trigger fires. All buffers are allocated at setup.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ljtrig.h"
+#include "ljtime.h"
+
+static struct ljtrig_data *first_trigger = NULL;
+
+// Append samples to circular history
+static void history_append (struct ljtrig_data *trig,
+                            const double *values, int count)
+{
+   int n;
+   if (trig->pre < 1)
+      return;
+   if (count > trig->pre)
+   {
+      // Only the newest samples fit
+      values += count - trig->pre;
+      count = trig->pre;
+   }
+   n = trig->pre - trig->head;
+   if (n > count)
+      n = count;
+   memcpy (trig->history + trig->head, values, n * sizeof (double));
+   memcpy (trig->history, values + n, (count - n) * sizeof (double));
+   trig->head = (trig->head + count) % trig->pre;
+   trig->filled += count;
+   if (trig->filled > trig->pre)
+      trig->filled = trig->pre;
+}
+
+// Index of first triggering sample in values[start..count) or count
+static int find_trigger (const struct ljtrig_data *trig,
+                         const double *values, int start, int count)
+{
+   double level = trig->level;
+   double prev = trig->last;
+   int i = start;
+
+   switch (trig->mode)
+   {
+   case LJTRIG_RISING:
+   case LJTRIG_FALLING:
+      if (i == 0)
+      {
+         if (!trig->has_last)
+            i++;        // No previous sample for the first edge
+      }
+      if (i >= count)
+         return count;
+      if (i > 0)
+         prev = values[i - 1];
+      if (trig->mode == LJTRIG_RISING)
+      {
+         for (; i < count; i++)
+         {
+            if (prev < level && values[i] >= level)
+               return i;
+            prev = values[i];
+         }
+      }
+      else
+      {
+         for (; i < count; i++)
+         {
+            if (prev > level && values[i] <= level)
+               return i;
+            prev = values[i];
+         }
+      }
+      break;
+   case LJTRIG_ABOVE:
+      for (; i < count; i++)
+         if (values[i] > level)
+            return i;
+      break;
+   case LJTRIG_BELOW:
+      for (; i < count; i++)
+         if (values[i] < level)
+            return i;
+      break;
+   }
+   return count;
+}
+
+// Send completed snapshot to spool and linked channels. Called with
+// trigger lock held. The lock is released while linked channels are
+// called, so they may push back to the trigger. Output buffer is taken
+// for the call and a nested or concurrent emit uses a temporary one.
+static void emit_snapshot (struct ljtrig_data *trig,
+                           const struct context_rmcios *context)
+{
+   int n = trig->snapshot_pre + trig->post;
+   float *output = trig->output;
+   int i;
+   trig->output = NULL;
+   if (output == NULL)
+      output = (float *) malloc (n * sizeof (float));
+   trig->triggers++;
+
+   // Lock order is trigger then spool
+   if (trig->spool != NULL)
+   {
+      double now = ljtime_monotonic ();
+      ljspool_append (trig->spool, now - (n - 1) * trig->interval,
+                      trig->interval, n, 1, trig->snapshot);
+   }
+   if (output == NULL)
+   {
+      printf ("trigger: Could not allocate snapshot\r\n");
+      return;
+   }
+   for (i = 0; i < n; i++)
+      output[i] = (float) trig->snapshot[i];
+
+   ljmutex_unlock (&trig->lock);
+   write_fv (context, linked_channels (context, trig->channel_id),
+             n, output);
+   ljmutex_lock (&trig->lock);
+
+   // Setup replaces the buffer of changed size while it is taken
+   if (trig->output == NULL && trig->snapshot != NULL)
+      trig->output = output;
+   else
+      free (output);
+}
+
+void ljtrig_push (struct ljtrig_data *trig,
+                  const struct context_rmcios *context,
+                  const double *values, int count)
+{
+   int i = 0;
+   if (trig == NULL || count < 1)
+      return;
+   ljmutex_lock (&trig->lock);
+   if (trig->snapshot == NULL)
+   {
+      ljmutex_unlock (&trig->lock);
+      return;
+   }
+
+   while (i < count)
+   {
+      if (trig->post_remaining > 0)
+      {
+         // Collect post trigger samples
+         int n = count - i;
+         if (n > trig->post_remaining)
+            n = trig->post_remaining;
+         memcpy (trig->snapshot + trig->snapshot_pre
+                 + trig->post - trig->post_remaining,
+                 values + i, n * sizeof (double));
+         history_append (trig, values + i, n);
+         trig->post_remaining -= n;
+         i += n;
+         if (trig->post_remaining == 0)
+         {
+            emit_snapshot (trig, context);
+            if (trig->snapshot == NULL)
+            {
+               // Setup failed while the lock was released
+               ljmutex_unlock (&trig->lock);
+               return;
+            }
+         }
+      }
+      else
+      {
+         // Armed: search for trigger in the rest of the block
+         int j = find_trigger (trig, values, i, count);
+         history_append (trig, values + i, j - i);
+         i = j;
+         if (i >= count)
+            break;
+
+         // Triggered: pre trigger history goes to start of snapshot
+         if (trig->pre > 0)
+         {
+            int start = (trig->head - trig->filled + trig->pre) % trig->pre;
+            int n = trig->pre - start;
+            if (n > trig->filled)
+               n = trig->filled;
+            memcpy (trig->snapshot, trig->history + start,
+                    n * sizeof (double));
+            memcpy (trig->snapshot + n, trig->history,
+                    (trig->filled - n) * sizeof (double));
+         }
+         trig->snapshot_pre = trig->filled;
+         trig->post_remaining = trig->post;
+      }
+   }
+   trig->last = values[count - 1];
+   trig->has_last = 1;
+   ljmutex_unlock (&trig->lock);
+}
+
+struct ljtrig_data *ljtrig_find (int channel_id)
+{
+   struct ljtrig_data *ptrig = first_trigger;
+   while (ptrig != NULL)
+   {
+      if (ptrig->channel_id == channel_id)
+         return ptrig;
+      ptrig = ptrig->next_trigger;
+   }
+   return NULL;
+}
+
+// Channel for triggered capture
+void ljtrig_func (struct ljtrig_data *this,
+                  const struct context_rmcios *context, int id,
+                  enum function_rmcios function,
+                  enum type_rmcios paramtype,
+                  struct combo_rmcios *returnv,
+                  int num_params, const union param_rmcios param)
+{
+   switch (function)
+   {
+   case help_rmcios:
+      return_string (context, returnv,
+                     "labjack trigger channel"
+                     " - pre/post trigger capture buffer\r\n"
+                     " create ljmtrig/ljtrig newname\r\n"
+                     " setup newname mode level | pre(100) | post(100)\r\n"
+                     "       | sample_interval(0)\r\n"
+                     "   #mode={rising, falling, above, below}\r\n"
+                     " setup newname spool spool_channel\r\n"
+                     "   #Also append snapshots to spool\r\n"
+                     " write newname value1 | value2 ...\r\n"
+                     "   #Evaluate trigger over samples. On trigger\r\n"
+                     "   #pre+post samples are sent to linked channels.\r\n"
+                     " read newname #Read number of snapshots\r\n"
+                     " link newname channel\r\n");
+      break;
+
+   case create_rmcios:
+      if (num_params < 1)
+         break;
+      // Allocate new data:
+      this = (struct ljtrig_data *) malloc (sizeof (struct ljtrig_data));
+      if (this == NULL)
+         break;
+
+      // Set default values:
+      memset (this, 0, sizeof (struct ljtrig_data));
+      this->mode = LJTRIG_RISING;
+      this->history = NULL;
+      this->snapshot = NULL;
+      this->output = NULL;
+      this->spool = NULL;
+      ljmutex_init (&this->lock);
+
+      // Create the channel
+      this->channel_id =
+         create_channel_param (context, paramtype, param, 0,
+                               (class_rmcios) ljtrig_func, this);
+
+      // Add trigger to list of triggers:
+      this->next_trigger = first_trigger;
+      first_trigger = this;
+      break;
+
+   case setup_rmcios:
+      if (this == NULL)
+         break;
+      if (num_params < 2)
+         break;
+      {
+         char buffer[20];
+         const char *mode;
+         mode = param_to_string (context, paramtype, param, 0,
+                                 sizeof (buffer), buffer);
+         if (strcmp (mode, "spool") == 0)
+         {
+            struct ljspool_data *spool =
+               ljspool_find (param_to_int (context, paramtype, param, 1));
+            if (spool == NULL)
+               printf ("trigger: Could not find spool channel\r\n");
+            ljmutex_lock (&this->lock);
+            this->spool = spool;
+            ljmutex_unlock (&this->lock);
+            break;
+         }
+         if (strcmp (mode, "rising") == 0)
+            this->mode = LJTRIG_RISING;
+         else if (strcmp (mode, "falling") == 0)
+            this->mode = LJTRIG_FALLING;
+         else if (strcmp (mode, "above") == 0)
+            this->mode = LJTRIG_ABOVE;
+         else if (strcmp (mode, "below") == 0)
+            this->mode = LJTRIG_BELOW;
+         else
+         {
+            printf ("trigger: Unknown mode %s\r\n", mode);
+            break;
+         }
+
+         ljmutex_lock (&this->lock);
+         this->level = param_to_float (context, paramtype, param, 1);
+         this->pre = 100;
+         this->post = 100;
+         this->interval = 0;
+         if (num_params > 2)
+            this->pre = param_to_int (context, paramtype, param, 2);
+         if (num_params > 3)
+            this->post = param_to_int (context, paramtype, param, 3);
+         if (num_params > 4)
+            this->interval = param_to_float (context, paramtype, param, 4);
+         if (this->pre < 0)
+            this->pre = 0;
+         if (this->post < 1)
+            this->post = 1;
+
+         // Preallocate buffers
+         free (this->history);
+         free (this->snapshot);
+         free (this->output);
+         this->history = malloc ((this->pre + 1) * sizeof (double));
+         this->snapshot =
+            malloc ((this->pre + this->post) * sizeof (double));
+         this->output = malloc ((this->pre + this->post) * sizeof (float));
+         if (this->history == NULL || this->snapshot == NULL
+             || this->output == NULL)
+         {
+            printf ("trigger: Could not allocate buffers\r\n");
+            free (this->history);
+            free (this->snapshot);
+            free (this->output);
+            this->history = NULL;
+            this->snapshot = NULL;
+            this->output = NULL;
+         }
+         this->head = 0;
+         this->filled = 0;
+         this->has_last = 0;
+         this->post_remaining = 0;
+         ljmutex_unlock (&this->lock);
+      }
+      break;
+
+   case write_rmcios:
+      if (this == NULL)
+         break;
+      if (num_params < 1)
+         break;
+      {
+         double values[num_params];
+         int i;
+         for (i = 0; i < num_params; i++)
+            values[i] = param_to_float (context, paramtype, param, i);
+         ljtrig_push (this, context, values, num_params);
+      }
+      break;
+
+   case read_rmcios:
+      if (this == NULL)
+         break;
+      {
+         int triggers;
+         ljmutex_lock (&this->lock);
+         triggers = this->triggers;
+         ljmutex_unlock (&this->lock);
+         return_int (context, returnv, triggers);
+      }
+      break;
+   }
+}
+
@@ -0,0 +1,67 @@
+/*
+ Pre/post trigger capture buffer for labjack acquisition.
+*/
+
+#ifndef ljtrig_h
+#define ljtrig_h
+
+#include "RMCIOS-functions.h"
+#include "ljspool.h"
+#include "ljthread.h"
+
+enum ljtrig_mode
+{
+   LJTRIG_RISING = 0,   // previous < level <= current
+   LJTRIG_FALLING,      // previous > level >= current
+   LJTRIG_ABOVE,        // current > level
+   LJTRIG_BELOW         // current < level
+};
+
+struct ljtrig_data
+{
+   int channel_id;
+   enum ljtrig_mode mode;
+   double level;
+   int pre;                     // Samples before trigger
+   int post;                    // Samples from trigger onwards
+   double interval;             // Seconds between samples (0 if unknown)
+
+   double *history;             // Circular pre-trigger history[pre]
+   int head;                    // Next write position in history
+   int filled;                  // Valid samples in history
+   double last;                 // Previous sample for edge detection
+   int has_last;
+
+   double *snapshot;            // Snapshot[pre + post] being collected
+   float *output;               // Snapshot converted for linked channels.
+                                // NULL while taken by emitting push.
+   int snapshot_pre;            // Pre-trigger samples in snapshot
+   int post_remaining;          // Post samples still to collect
+   int triggers;                // Completed snapshots
+
+   struct ljspool_data *spool;
+   ljmutex_t lock;              // Serializes pushes and setup
+   struct ljtrig_data *next_trigger;
+};
+
+// Evaluate triggers over a block of samples and emit completed snapshots
+// to linked channels. Pushes from several threads are serialized, except
+// while linked channels are called. Linked channels may push back to the
+// trigger.
+void ljtrig_push (struct ljtrig_data *trig,
+                  const struct context_rmcios *context,
+                  const double *values, int count);
+
+// Find trigger channel by its channel id. Returns NULL if not found.
+struct ljtrig_data *ljtrig_find (int channel_id);
+
+// Channel for triggered capture
+void ljtrig_func (struct ljtrig_data *this,
+                  const struct context_rmcios *context, int id,
+                  enum function_rmcios function,
+                  enum type_rmcios paramtype,
+                  struct combo_rmcios *returnv,
+                  int num_params, const union param_rmcios param);
+
+#endif
+